@@ -0,0 +1,97 @@
+#include "AudioMixerMulti.h"
+
+#if defined(__ARM_ARCH_7EM__)
+#include "utility/dspinst.h"
+#endif
+
+void mixAccumulate(int32_t *acc, const int16_t * const *in, const int32_t *gain, uint32_t n) {
+    // accumulate in 32 bit, each product saturated to 16 bit like AudioMixer4
+    if (!n) {
+        memset(acc, 0, AUDIO_BLOCK_SAMPLES * sizeof(int32_t));
+        return;
+    }
+#if defined(__ARM_ARCH_7EM__)
+    // two samples per word: SMULWB/SMULWT multiply by the Q16 gain, SSAT saturates
+    for (uint32_t k = 0; k < n; k++) {
+        const uint32_t *src = (const uint32_t *)in[k];
+        const int32_t mult = gain[k];
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES / 2; i++) {
+            uint32_t pair = src[i];
+            int32_t lo = signed_saturate_rshift(signed_multiply_32x16b(mult, pair), 16, 0);
+            int32_t hi = signed_saturate_rshift(signed_multiply_32x16t(mult, pair), 16, 0);
+            if (k) {
+                acc[2 * i] += lo;
+                acc[2 * i + 1] += hi;
+            } else {
+                acc[2 * i] = lo;
+                acc[2 * i + 1] = hi;
+            }
+        }
+    }
+#else
+    for (uint32_t k = 0; k < n; k++) {
+        const int16_t *src = in[k];
+        const int64_t mult = gain[k];
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+            int32_t v = (src[i] * mult) >> 16;
+            if (v > 32767) v = 32767;
+            else if (v < -32768) v = -32768;
+            acc[i] = k ? acc[i] + v : v;
+        }
+    }
+#endif
+}
+
+void mixSaturating(int16_t *out, const int16_t * const *in, const int32_t *gain, uint32_t n) {
+    // saturate the sum once
+    int32_t acc[AUDIO_BLOCK_SAMPLES];
+    mixAccumulate(acc, in, gain, n);
+#if defined(__ARM_ARCH_7EM__)
+    // PKHBT packs two results into one word
+    uint32_t *dst = (uint32_t *)out;
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES / 2; i++) {
+        dst[i] = pack_16b_16b(signed_saturate_rshift(acc[2 * i + 1], 16, 0), signed_saturate_rshift(acc[2 * i], 16, 0));
+    }
+#else
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        int32_t v = acc[i];
+        if (v > 32767) v = 32767;
+        else if (v < -32768) v = -32768;
+        out[i] = v;
+    }
+#endif
+}
+
+void mixMinusSaturating(int16_t *out, const int32_t *acc, const int16_t *in, int32_t gain) {
+    if (!in || !gain) {
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+            int32_t v = acc[i];
+            if (v > 32767) v = 32767;
+            else if (v < -32768) v = -32768;
+            out[i] = v;
+        }
+        return;
+    }
+#if defined(__ARM_ARCH_7EM__)
+    // the products must match mixAccumulate() exactly, so the input cancels out
+    const uint32_t *src = (const uint32_t *)in;
+    uint32_t *dst = (uint32_t *)out;
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES / 2; i++) {
+        uint32_t pair = src[i];
+        int32_t lo = acc[2 * i] - signed_saturate_rshift(signed_multiply_32x16b(gain, pair), 16, 0);
+        int32_t hi = acc[2 * i + 1] - signed_saturate_rshift(signed_multiply_32x16t(gain, pair), 16, 0);
+        dst[i] = pack_16b_16b(signed_saturate_rshift(hi, 16, 0), signed_saturate_rshift(lo, 16, 0));
+    }
+#else
+    const int64_t mult = gain;
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        int32_t v = (in[i] * mult) >> 16;
+        if (v > 32767) v = 32767;
+        else if (v < -32768) v = -32768;
+        v = acc[i] - v;
+        if (v > 32767) v = 32767;
+        else if (v < -32768) v = -32768;
+        out[i] = v;
+    }
+#endif
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Audio.h"
+
+/**
+ * @brief Mix n input blocks into one output block: out = saturate(sum(in[k] * gain[k])), in one pass
+ *
+ * @param out destination (AUDIO_BLOCK_SAMPLES samples)
+ * @param in source blocks (AUDIO_BLOCK_SAMPLES samples each)
+ * @param gain gain of each source, 65536 is 1.0
+ * @param n number of sources, at least 1
+ */
+void mixSaturating(int16_t *out, const int16_t * const *in, const int32_t *gain, uint32_t n);
+
+/**
+ * @brief Sum n input blocks without saturating the sum: acc = sum(in[k] * gain[k]) (each product saturated to 16 bit)
+ *
+ * @param acc destination (AUDIO_BLOCK_SAMPLES values)
+ * @param in source blocks (AUDIO_BLOCK_SAMPLES samples each)
+ * @param gain gain of each source, 65536 is 1.0
+ * @param n number of sources, 0 clears acc
+ */
+void mixAccumulate(int32_t *acc, const int16_t * const *in, const int32_t *gain, uint32_t n);
+
+/**
+ * @brief Remove one source from a sum of mixAccumulate(): out = saturate(acc - in * gain)
+ *
+ * @param out destination (AUDIO_BLOCK_SAMPLES samples)
+ * @param acc sum that contains in * gain
+ * @param in source block (AUDIO_BLOCK_SAMPLES samples), nullptr if it is not part of the sum
+ * @param gain gain of the source in the sum, 65536 is 1.0
+ */
+void mixMinusSaturating(int16_t *out, const int32_t *acc, const int16_t *in, int32_t gain);
+
+/**
+ * @brief Mixer with N inputs. Replaces a tree of AudioMixer4: no intermediate blocks, each sample is saturated once.
+ *        Inputs without a block (stopped or not connected) and inputs with gain 0 are skipped.
+ *
+ * @tparam N number of inputs
+ */
+template <int N>
+class AudioMixerMulti : public AudioStream {
+  public:
+    AudioMixerMulti(void) : AudioStream(N, inputQueueArray) {
+      for (int i = 0; i < N; i++) multiplier[i] = 65536;
+    }
+
+    /**
+     * @brief Set the gain of an input (like AudioMixer4::gain)
+     *
+     * @param channel input [0..N-1]
+     * @param gain -32767.0...32767.0
+     */
+    void gain(unsigned int channel, float gain) {
+      if (channel >= N) return;
+      if (gain > 32767.0f) gain = 32767.0f;
+      else if (gain < -32767.0f) gain = -32767.0f;
+      multiplier[channel] = gain * 65536.0f;
+    }
+
+    virtual void update(void) {
+      audio_block_t *block[N];
+      const int16_t *data[N];
+      int32_t mult[N];
+      uint32_t n = 0;
+      for (int i = 0; i < N; i++) {
+        block[i] = receiveReadOnly(i);
+        if (block[i] && multiplier[i]) {
+          data[n] = block[i]->data;
+          mult[n] = multiplier[i];
+          n++;
+        }
+      }
+      if (n) {
+        audio_block_t *out = allocate();
+        if (out) {
+          mixSaturating(out->data, data, mult, n);
+          transmit(out);
+          release(out);
+        }
+      }
+      for (int i = 0; i < N; i++) {
+        if (block[i]) release(block[i]);
+      }
+    }
+
+  private:
+    int32_t multiplier[N];
+    audio_block_t *inputQueueArray[N];
+};
@@ -0,0 +1,209 @@
+#include "Benchmark.h"
+
+#if defined(__IMXRT1062__)
+#define BENCHMARK_UNIT "cycles"
+static inline uint32_t ticks() { return ARM_DWT_CYCCNT; }
+static inline void advanceClock(uint32_t us) {} // micros() runs in real time
+#else
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCHMARK_UNIT "tsc"
+static inline uint32_t ticks() { return (uint32_t)__rdtsc(); }
+#else
+#define BENCHMARK_UNIT "ns"
+static inline uint32_t ticks() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+#endif
+// the host's micros() is virtual: let the packets arrive at the pace of the audio clock
+static inline void advanceClock(uint32_t us) { HostClock::set(HostClock::get() + us); }
+#endif
+
+#define BENCHMARK_WARMUP_PACKETS (64)
+#define BENCHMARK_BLOCK_US ((uint32_t)(AUDIO_BLOCK_SAMPLES * 1000000 / AUDIO_SAMPLE_RATE_EXACT))
+
+static uint8_t packet[OPENREMJAM_MONO_PACKET_SIZE] __attribute__((aligned(4)));
+static int16_t mix_in[OPENREMJAM_MAX_PEERS][AUDIO_BLOCK_SAMPLES] __attribute__((aligned(4)));
+static int16_t mix_out[AUDIO_BLOCK_SAMPLES] __attribute__((aligned(4)));
+static volatile int32_t sink; // keeps results alive
+
+void Benchmark::run(QueueController &qc, boolean header) {
+#if defined(__IMXRT1062__)
+    ARM_DEMCR |= ARM_DEMCR_TRCENA; // the core enables the cycle counter at startup, make sure
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+    int16_t *samples = (int16_t *)&packet[OPENREMJAM_HEADER_SIZE];
+    for (int i = 0; i < OPENREMJAM_SAMPLES_PER_NETWORK_BLOCK; ++i) samples[i] = 8000 * sin(i * 0.0626f);
+    for (int k = 0; k < OPENREMJAM_MAX_PEERS; ++k) memcpy(mix_in[k], &samples[k], sizeof(mix_in[k]));
+
+    if (header) {
+        Serial.printf("# OpenRemjam benchmarks: AUDIO_BLOCK_SAMPLES=%d, OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK=%d, %d calls each\r\n",
+                      AUDIO_BLOCK_SAMPLES, OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK, OPENREMJAM_BENCHMARK_CALLS);
+        Serial.println("benchmark,scenario,queues,block_samples,unit,calls,min,avg,max,block_budget");
+    }
+
+    stream(qc, "in_order", 0, false, false, false);
+    stream(qc, "reordered", 0, true, false, false);
+    stream(qc, "gap", 8, false, false, false);
+    stream(qc, "in_order", 0, false, true, false);  // enqueue(), copies the packet
+    stream(qc, "in_order", 0, false, false, true);  // update() with the drift compensating resampler
+
+    const int queue_counts[] = {1, 4, 16};
+    for (int n : queue_counts) {
+        if (n > OPENREMJAM_MAX_PEERS) continue;
+        lookup(qc, n);
+        mix(n);
+        cycle(qc, n);
+    }
+    connectQueues(qc, 0);
+}
+
+uint32_t Benchmark::blockBudget() {
+#if defined(__IMXRT1062__)
+    return (uint64_t)F_CPU_ACTUAL * AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT;
+#elif defined(__x86_64__) || defined(__i386__)
+    // the TSC rate: count it for 20 ms of wall clock time
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t tsc0 = __rdtsc();
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+    } while ((t1.tv_sec - t0.tv_sec) * 1000000000ll + (t1.tv_nsec - t0.tv_nsec) < 20000000ll);
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    return (__rdtsc() - tsc0) / ns * (AUDIO_BLOCK_SAMPLES * 1e9 / AUDIO_SAMPLE_RATE_EXACT);
+#else
+    return AUDIO_BLOCK_SAMPLES * 1e9 / AUDIO_SAMPLE_RATE_EXACT;
+#endif
+}
+
+void Benchmark::print(const char *benchmark, const char *scenario, int queues, const RunningStat &s) {
+    static uint32_t budget = 0;
+    if (!budget) budget = blockBudget();
+    Serial.printf("%s,%s,%d,%d,%s,%lu,%lu,%lu,%lu,%lu\r\n", benchmark, scenario, queues, AUDIO_BLOCK_SAMPLES,
+                  BENCHMARK_UNIT, s.getCount(), s.getMin(), s.getAvg(), s.getMax(), budget);
+}
+
+void Benchmark::connectQueues(QueueController &qc, int n) {
+    // disconnect first: the queues start over (syncing) with the seqno of the first packet
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+        if (qc.getQueue(i)->getPort()) qc.disconnect(i);
+    }
+    for (int i = 0; i < n; ++i) {
+        qc.connect(i, IPAddress(10, 0, 0, i + 1), OPENREMJAM_DEFAULT_UDP_PORT);
+        qc.getQueue(i)->setDriftCompensation(false);
+    }
+}
+
+void Benchmark::receive(NetworkJitterBufferPlayQueue *q, uint32_t seqno, boolean copy) {
+    // what receivePackets() does once the header is read: a payload that arrived at once (no socket read)
+    openremjam_header_t *h = (openremjam_header_t *)packet;
+    fillHeader(*h, PacketType::audio, Codec::pcm, seqno, OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK, 0);
+    if (copy) {
+        q->enqueue(packet, OPENREMJAM_MONO_PACKET_SIZE);
+        return;
+    }
+    uint8_t *payload = q->getPayloadBuffer(*h, OPENREMJAM_MONO_PACKET_SIZE);
+    if (!payload) return;
+    memcpy(payload, &packet[OPENREMJAM_HEADER_SIZE], OPENREMJAM_MONO_PACKET_SIZE - OPENREMJAM_HEADER_SIZE);
+    q->commitPayload(*h);
+}
+
+void Benchmark::stream(QueueController &qc, const char *scenario, uint32_t lost_every, boolean reorder, boolean copy, boolean drift) {
+    connectQueues(qc, 1);
+    NetworkJitterBufferPlayQueue *q = qc.getQueue(0);
+    q->setDriftCompensation(drift);
+    RunningStat rx, update;
+    for (uint32_t k = 0; k < BENCHMARK_WARMUP_PACKETS + OPENREMJAM_BENCHMARK_CALLS; ++k) {
+        boolean measure = k >= BENCHMARK_WARMUP_PACKETS;
+        uint32_t seqno = reorder ? k ^ 1 : k;
+        if (!lost_every || seqno % lost_every != lost_every - 1) {
+            uint32_t t0 = ticks();
+            receive(q, seqno, copy);
+            uint32_t t = ticks() - t0;
+            if (measure) rx.add(t);
+        }
+        for (int b = 0; b < OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK; ++b) {
+            advanceClock(BENCHMARK_BLOCK_US);
+            uint32_t t0 = ticks();
+            q->update();
+            uint32_t t = ticks() - t0;
+            if (measure) update.add(t);
+        }
+    }
+    if (!drift) print(copy ? "enqueue" : "receive", scenario, 1, rx);
+    if (!copy) print(drift ? "update_resampled" : "update", scenario, 1, update);
+}
+
+void Benchmark::lookup(QueueController &qc, int n) {
+    connectQueues(qc, n);
+    RunningStat hit, miss;
+    for (uint32_t k = 0; k < OPENREMJAM_BENCHMARK_CALLS; ++k) {
+        fnet_ip4_addr_t ip = IPAddress(10, 0, 0, k % n + 1);
+        uint32_t t0 = ticks();
+        sink = qc.getQueueIndexByIPv4(ip, OPENREMJAM_DEFAULT_UDP_PORT);
+        uint32_t t = ticks() - t0;
+        hit.add(t);
+        ip = IPAddress(10, 1, 0, k % 251 + 1);
+        t0 = ticks();
+        sink = qc.getQueueIndexByIPv4(ip, OPENREMJAM_DEFAULT_UDP_PORT);
+        t = ticks() - t0;
+        miss.add(t);
+    }
+    print("lookup", "hit", n, hit);
+    print("lookup", "miss", n, miss);
+}
+
+void Benchmark::mix(int n) {
+    const int16_t *in[OPENREMJAM_MAX_PEERS];
+    int32_t gain[OPENREMJAM_MAX_PEERS];
+    for (int i = 0; i < n; ++i) {
+        in[i] = mix_in[i];
+        gain[i] = 65536;
+    }
+    RunningStat full, minus;
+    int32_t acc[AUDIO_BLOCK_SAMPLES];
+    for (uint32_t k = 0; k < OPENREMJAM_BENCHMARK_CALLS; ++k) {
+        uint32_t t0 = ticks();
+        mixSaturating(mix_out, in, gain, n);
+        uint32_t t = ticks() - t0;
+        full.add(t);
+        sink = mix_out[k % AUDIO_BLOCK_SAMPLES];
+        // server mode: the sum once, then one mix-minus per client
+        t0 = ticks();
+        mixAccumulate(acc, in, gain, n);
+        for (int i = 0; i < n; ++i) mixMinusSaturating(mix_out, acc, in[i], gain[i]);
+        t = ticks() - t0;
+        minus.add(t);
+        sink = mix_out[k % AUDIO_BLOCK_SAMPLES];
+    }
+    print("mix", "saturating", n, full);
+    print("mix", "mix_minus", n, minus);
+}
+
+void Benchmark::cycle(QueueController &qc, int n) {
+    // everything the play path does per audio block: one update() per queue, then the mix of their blocks
+    connectQueues(qc, n);
+    const int16_t *in[OPENREMJAM_MAX_PEERS];
+    int32_t gain[OPENREMJAM_MAX_PEERS];
+    for (int i = 0; i < n; ++i) {
+        in[i] = mix_in[i];
+        gain[i] = 65536;
+    }
+    RunningStat blocks;
+    const uint32_t packets = BENCHMARK_WARMUP_PACKETS + OPENREMJAM_BENCHMARK_CALLS / OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK;
+    for (uint32_t k = 0; k < packets; ++k) {
+        for (int i = 0; i < n; ++i) receive(qc.getQueue(i), k, false);
+        for (int b = 0; b < OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK; ++b) {
+            advanceClock(BENCHMARK_BLOCK_US);
+            uint32_t t0 = ticks();
+            for (int i = 0; i < n; ++i) qc.getQueue(i)->update();
+            mixSaturating(mix_out, in, gain, n);
+            uint32_t t = ticks() - t0;
+            if (k >= BENCHMARK_WARMUP_PACKETS) blocks.add(t);
+        }
+    }
+    print("cycle", "in_order", n, blocks);
+}
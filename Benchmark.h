@@ -0,0 +1,41 @@
+#pragma once
+
+#define OPENREMJAM_BENCHMARK (0)                          // default: 0 (1: setup() runs the microbenchmarks, prints the results and stops)
+#define OPENREMJAM_BENCHMARK_CALLS (2000)                 // default: 2000 (measured calls per benchmark, after a warm-up)
+
+#include "Audio.h"
+#include "QueueController.h"
+#include "RunningStat.h"
+
+/**
+ * @brief Microbenchmarks of the hot paths: receiving a packet into a queue (zero-copy and enqueue()), one queue
+ *        update(), the peer lookup, the mixer and a whole audio cycle (all queue updates plus the mix), for in-order
+ *        arrival, reordering (pairs swapped) and gaps (every 8th packet lost), with 1, 4 and 16 active queues.
+ *        Each call is measured on its own: with the DWT cycle counter on the Teensy, the TSC on x86 hosts, and
+ *        clock_gettime() elsewhere. The results are printed as CSV (one line per benchmark); "block_budget" is the
+ *        duration of one audio block in the same unit, the CPU budget of everything that runs per block.
+ *        Uses the queues of qc (they are disconnected afterwards) and calls update() directly, so the audio interrupt
+ *        must not run meanwhile (AudioNoInterrupts()).
+ *
+ */
+class Benchmark {
+  public:
+
+    /**
+     * @brief Run all benchmarks and print the results via Serial
+     *
+     * @param qc queue controller, its queues are measured
+     * @param header print the comment and CSV header lines first
+     */
+    static void run(QueueController &qc, boolean header = true);
+
+  private:
+    static uint32_t blockBudget();
+    static void print(const char *benchmark, const char *scenario, int queues, const RunningStat &s);
+    static void connectQueues(QueueController &qc, int n);
+    static void receive(NetworkJitterBufferPlayQueue *q, uint32_t seqno, boolean copy);
+    static void stream(QueueController &qc, const char *scenario, uint32_t lost_every, boolean reorder, boolean copy, boolean drift);
+    static void lookup(QueueController &qc, int n);
+    static void mix(int n);
+    static void cycle(QueueController &qc, int n);
+};
@@ -0,0 +1,216 @@
+#include "ControlEndpoint.h"
+
+ControlEndpoint::ControlEndpoint(QueueController &q) : qc(q), started(false), subscribers{}, buf{} {}
+
+void ControlEndpoint::begin(uint16_t port) {
+    started = udp.begin(port);
+    if (!started) Serial.println("Warning: ControlEndpoint::begin() -- cannot open the control port!");
+}
+
+void ControlEndpoint::poll() {
+    if (!started) return;
+    int size;
+    while ((size = udp.parsePacket()) > 0) {
+        if (size > (int)sizeof(buf)) continue; // not ours, dropped by the next parsePacket()
+        udp.read((uint8_t *)buf, size);
+        handle(size);
+    }
+
+    uint32_t now = millis();
+    for (subscriber_t &s : subscribers) {
+        if (!s.sa.sa_port) continue;
+        if (now - s.renewed > OPENREMJAM_CONTROL_LEASE_MS) {
+            s.sa.sa_port = 0; // the client is gone
+            continue;
+        }
+        if (now - s.last_sent >= s.interval_ms) {
+            s.last_sent = now;
+            sendTelemetry(s);
+        }
+    }
+}
+
+void ControlEndpoint::handle(uint32_t size) {
+    const control_header_t &h = *(const control_header_t *)buf;
+    if (size < sizeof(control_header_t) || h.magic != OPENREMJAM_CONTROL_MAGIC || h.version != OPENREMJAM_CONTROL_VERSION) return;
+
+    ControlStatus status = ControlStatus::unsupported;
+    switch (h.type) {
+        case ControlType::subscribe:
+            if (size >= sizeof(control_subscribe_t)) status = subscribe(*(const control_subscribe_t *)buf);
+            break;
+        case ControlType::set:
+            if (size >= sizeof(control_set_t)) status = set(*(const control_set_t *)buf);
+            break;
+        case ControlType::connect:
+            if (size >= sizeof(control_connect_t)) status = connect(*(const control_connect_t *)buf);
+            break;
+        case ControlType::disconnect:
+            if (size >= sizeof(control_set_t)) {
+                const control_set_t &m = *(const control_set_t *)buf;
+                if (m.queue >= OPENREMJAM_MAX_PEERS) {
+                    status = ControlStatus::invalid_queue;
+                } else {
+                    qc.disconnect(m.queue);
+                    Serial.printf("Control: queue %d disconnected\r\n", m.queue);
+                    status = ControlStatus::ok;
+                }
+            }
+            break;
+        default:
+            return; // telemetry and acks are sent by us, never answered
+    }
+    sendAck(h, status);
+}
+
+ControlStatus ControlEndpoint::subscribe(const control_subscribe_t &m) {
+    struct fnet_sockaddr sa;
+    getRemote(sa);
+    subscriber_t *slot = nullptr;
+    for (subscriber_t &s : subscribers) {
+        if (s.sa.sa_port && !memcmp(&s.sa, &sa, sizeof(sa))) {
+            slot = &s; // renew
+            break;
+        }
+        if (!s.sa.sa_port && !slot) slot = &s;
+    }
+    if (!m.interval_ms) {
+        if (slot && slot->sa.sa_port) slot->sa.sa_port = 0;
+        return ControlStatus::ok;
+    }
+    if (m.interval_ms < OPENREMJAM_CONTROL_MIN_INTERVAL_MS) return ControlStatus::invalid_value;
+    if (!slot) return ControlStatus::full;
+    if (!slot->sa.sa_port) {
+        slot->sa = sa;
+        slot->seqno = 0;
+        slot->last_sent = millis() - m.interval_ms; // first snapshot right away
+    }
+    slot->interval_ms = m.interval_ms;
+    slot->renewed = millis();
+    return ControlStatus::ok;
+}
+
+ControlStatus ControlEndpoint::set(const control_set_t &m) {
+    if (m.queue >= OPENREMJAM_MAX_PEERS) return ControlStatus::invalid_queue;
+    NetworkJitterBufferPlayQueue *q = qc.getQueue(m.queue);
+    int32_t v = m.value;
+    switch (m.param) {
+        case ControlParam::max_buffers:
+            if (v < 2 || v > (int32_t)q->getCapacity()) return ControlStatus::invalid_value;
+            q->setMaxBuffers(v);
+            break;
+        case ControlParam::prefill:
+            if (v < 1 || v >= q->getMaxBuffers()) return ControlStatus::invalid_value;
+            q->setPrefill(v);
+            break;
+        case ControlParam::gain:
+            if (v < 0) return ControlStatus::invalid_value;
+            qc.setGain(m.queue, v / 1000.0f);
+            break;
+        case ControlParam::adaptive:
+            if (v < 0 || v > 1) return ControlStatus::invalid_value;
+            q->setAdaptive(v);
+            break;
+        case ControlParam::drift:
+            if (v < 0 || v > 1) return ControlStatus::invalid_value;
+            q->setDriftCompensation(v);
+            break;
+        case ControlParam::codec:
+            if (v < 0 || v > 1) return ControlStatus::invalid_value;
+            q->setSendCodec(v ? Codec::adpcm : Codec::pcm);
+            break;
+        case ControlParam::capacity:
+            if (v < 2 || !q->isValidCapacity(v)) return ControlStatus::invalid_value;
+            if (q->getPort() && !q->canAcquireSlots(v)) return ControlStatus::no_slots;
+            if (!qc.setCapacity(m.queue, v)) return ControlStatus::no_slots;
+            break;
+        default:
+            return ControlStatus::unsupported;
+    }
+    Serial.printf("Control: queue %d parameter %d set to %ld\r\n", m.queue, (int)m.param, v);
+    return ControlStatus::ok;
+}
+
+ControlStatus ControlEndpoint::connect(const control_connect_t &m) {
+    if (m.queue >= OPENREMJAM_MAX_PEERS) return ControlStatus::invalid_queue;
+    if (!m.ip || !m.port) return ControlStatus::invalid_value;
+    IPAddress ip(m.ip);
+    if (!qc.connect(m.queue, ip, m.port)) return ControlStatus::no_slots;
+    Serial.printf("Control: queue %d connected to %d.%d.%d.%d:%d\r\n", m.queue, ip[0], ip[1], ip[2], ip[3], m.port);
+    return ControlStatus::ok;
+}
+
+void ControlEndpoint::sendAck(const control_header_t &request, ControlStatus status) {
+    control_ack_t ack = {};
+    ack.h = request;
+    ack.h.type = ControlType::ack;
+    ack.request = request.type;
+    ack.status = status;
+    struct fnet_sockaddr sa;
+    getRemote(sa);
+    sendTo(sa, &ack, sizeof(ack));
+}
+
+void ControlEndpoint::sendTelemetry(subscriber_t &s) {
+    control_telemetry_t *t = (control_telemetry_t *)buf;
+    control_queue_t *queues = (control_queue_t *)&t[1];
+    int i = 0;
+    do {
+        // one snapshot, split into messages of up to OPENREMJAM_CONTROL_QUEUES_PER_PACKET queues
+        uint32_t n = 0;
+        for (; i < OPENREMJAM_MAX_PEERS && n < OPENREMJAM_CONTROL_QUEUES_PER_PACKET; ++i) {
+            if (qc.getQueue(i)->getPort()) fillQueue(i, queues[n++]);
+        }
+        memset(t, 0, sizeof(*t));
+        t->h.magic = OPENREMJAM_CONTROL_MAGIC;
+        t->h.version = OPENREMJAM_CONTROL_VERSION;
+        t->h.type = ControlType::telemetry;
+        t->h.seqno = s.seqno;
+        t->uptime_ms = millis();
+        t->queues = n;
+        t->more = i < OPENREMJAM_MAX_PEERS;
+        sendTo(s.sa, buf, sizeof(*t) + n * sizeof(control_queue_t));
+    } while (i < OPENREMJAM_MAX_PEERS);
+    s.seqno++;
+}
+
+void ControlEndpoint::fillQueue(int i, control_queue_t &c) {
+    NetworkJitterBufferPlayQueue *q = qc.getQueue(i);
+    memset(&c, 0, sizeof(c));
+    c.ip = q->getIPv4();
+    c.port = q->getPort();
+    c.queue = i;
+    c.flags = (q->getAdaptive() ? OPENREMJAM_CONTROL_FLAG_ADAPTIVE : 0) |
+              (q->getDriftCompensation() ? OPENREMJAM_CONTROL_FLAG_DRIFT : 0) |
+              (q->getSendCodec() == Codec::adpcm ? OPENREMJAM_CONTROL_FLAG_ADPCM : 0);
+    c.queue_length = q->getQueueLength();
+    c.prefill = q->getPrefill();
+    c.max_buffers = q->getMaxBuffers();
+    c.capacity = q->getCapacity();
+    c.gain = (int32_t)(qc.getGain(i) * 1000.0f + 0.5f);
+    c.drift = (int32_t)(q->getDriftPpm() * 1000.0f);
+    c.jitter = q->getJitter();
+    c.jitter_p99 = q->getJitterPercentile(0.99f);
+    c.rtt = q->getRtt().getAvg();
+    c.buffering_delay = q->getBufferingDelay().getAvg();
+    c.latency = q->getLatency().getAvg();
+    c.early_packets = q->getEarlyPackets();
+    c.late_packets = q->getLatePackets();
+    c.recoveries_success = q->getRecoveriesSuccess();
+    c.recoveries_failed = q->getRecoveriesFailed();
+    c.concealed_packets = q->getConcealedPackets();
+    c.fec_recovered_packets = q->getFecRecoveredPackets();
+    c.rejected_packets = q->getRejectedPackets();
+}
+
+void ControlEndpoint::sendTo(const struct fnet_sockaddr &sa, const void *data, uint32_t size) {
+    fnet_socket_sendto(udp.getSocket(), (fnet_uint8_t *)data, size, 0, &sa, sizeof(sa));
+}
+
+void ControlEndpoint::getRemote(struct fnet_sockaddr &sa) {
+    memset(&sa, 0, sizeof(sa));
+    fnet_sockaddr_in *sa_ptr = (fnet_sockaddr_in *)&sa; // re-use this struct for IPv4 (it's comaptible!)
+    sa_ptr->sin_family = AF_INET;
+    sa_ptr->sin_port = fnet_htons(udp.remotePort());
+    sa_ptr->sin_addr.s_addr = udp.remoteIP();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "fnet.h"
+#include "NativeEthernet.h"
+#include "ControlProtocol.h"
+#include "QueueController.h"
+#include "FanoutSender.h"
+
+/**
+ * @brief Telemetry and control on a separate UDP port (OPENREMJAM_CONTROL_UDP_PORT), see ControlProtocol.h and the
+ *        host tool host/ctl/openremjam-ctl. Clients subscribe to periodic per-queue statistics snapshots and change
+ *        buffer depth, prefill, gain, codec and connections at runtime. Runs in loop(), like the serial commands.
+ *        There is no authentication: expose the port on a trusted network only.
+ *
+ */
+class ControlEndpoint {
+  public:
+
+    /**
+     * @brief Construct a new ControlEndpoint object
+     *
+     * @param qc queues to report and control
+     */
+    ControlEndpoint(QueueController &qc);
+
+    /**
+     * @brief Open the UDP port (after Ethernet has been initialized)
+     *
+     * @param port local port
+     */
+    void begin(uint16_t port = OPENREMJAM_CONTROL_UDP_PORT);
+
+    /**
+     * @brief Handle all pending requests and send the telemetry that is due (call from loop())
+     *
+     */
+    void poll();
+
+  private:
+    typedef struct subscriber_struct {
+      struct fnet_sockaddr sa;  // client address and port, sa_port 0: unused slot
+      uint32_t interval_ms;
+      uint32_t last_sent;       // millis()
+      uint32_t renewed;         // millis() of the last subscribe message
+      uint32_t seqno;           // telemetry messages sent
+    } subscriber_t;
+
+    QueueController &qc;
+    FnetUDP udp;
+    boolean started;
+    subscriber_t subscribers[OPENREMJAM_CONTROL_MAX_SUBSCRIBERS];
+    uint32_t buf[OPENREMJAM_CONTROL_MAX_PACKET_SIZE / 4]; // requests and telemetry
+
+    void handle(uint32_t size);
+    ControlStatus subscribe(const control_subscribe_t &m);
+    ControlStatus set(const control_set_t &m);
+    ControlStatus connect(const control_connect_t &m);
+    void sendAck(const control_header_t &request, ControlStatus status);
+    void sendTelemetry(subscriber_t &s);
+    void fillQueue(int i, control_queue_t &q);
+    void sendTo(const struct fnet_sockaddr &sa, const void *data, uint32_t size);
+    void getRemote(struct fnet_sockaddr &sa);
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+#define OPENREMJAM_CONTROL_UDP_PORT (9001)                // default: 9001 (telemetry and control, see ControlEndpoint)
+#define OPENREMJAM_CONTROL_MAX_SUBSCRIBERS (4)            // default: 4 (clients that receive telemetry at the same time)
+#define OPENREMJAM_CONTROL_LEASE_MS (10000)               // default: 10000 (a subscription ends unless it is renewed within this time)
+#define OPENREMJAM_CONTROL_MIN_INTERVAL_MS (100)          // default: 100 (shortest telemetry interval: the endpoint is not authenticated, so a spoofed subscription must not turn the device into a traffic source, nor delay receiving audio in loop())
+
+// DO NOT CHANGE THESE:
+#define OPENREMJAM_CONTROL_MAGIC (0x4352)                 // "RC" (little endian)
+#define OPENREMJAM_CONTROL_VERSION (1)
+#define OPENREMJAM_CONTROL_QUEUES_PER_PACKET (16)         // telemetry: 16 + 16 * 68 bytes fit into an Ethernet frame
+#define OPENREMJAM_CONTROL_MAX_PACKET_SIZE (16 + OPENREMJAM_CONTROL_QUEUES_PER_PACKET * 68)
+
+// This header is shared by the firmware (ControlEndpoint) and the host tool (host/ctl/openremjam-ctl), so it only
+// depends on stdint.h. All fields are little endian.
+
+#include <stdint.h>
+
+/**
+ * @brief Kind of control message
+ *
+ */
+enum class ControlType : uint8_t {
+  subscribe,    // client -> device: control_subscribe_t, send telemetry to the sender of this message
+  telemetry,    // device -> client: control_telemetry_t, followed by one control_queue_t per connected queue
+  set,          // client -> device: control_set_t
+  connect,      // client -> device: control_connect_t
+  disconnect,   // client -> device: control_set_t (value unused)
+  ack           // device -> client: control_ack_t, answers subscribe, set, connect and disconnect
+};
+
+/**
+ * @brief Queue parameter changed by ControlType::set
+ *
+ */
+enum class ControlParam : uint8_t {
+  max_buffers,  // NetworkJitterBufferPlayQueue::setMaxBuffers(), also sets prefill to max_buffers / 2
+  prefill,      // NetworkJitterBufferPlayQueue::setPrefill()
+  gain,         // QueueController::setGain(), value in 1/1000
+  adaptive,     // NetworkJitterBufferPlayQueue::setAdaptive(), 0 or 1
+  drift,        // NetworkJitterBufferPlayQueue::setDriftCompensation(), 0 or 1
+  codec,        // NetworkJitterBufferPlayQueue::setSendCodec(), 0: pcm, 1: adpcm
+  capacity      // QueueController::setCapacity(), restarts a connected queue
+};
+
+/**
+ * @brief Result of a request
+ *
+ */
+enum class ControlStatus : uint8_t {
+  ok,
+  invalid_queue,
+  invalid_value,  // also subscribe: interval_ms below OPENREMJAM_CONTROL_MIN_INTERVAL_MS
+  unsupported,  // unknown message type or parameter
+  full,         // subscribe: OPENREMJAM_CONTROL_MAX_SUBSCRIBERS clients are subscribed already
+  no_slots      // connect, set capacity: the block pool has too few free slots for the queue
+};
+
+/**
+ * @brief Header in front of every control message
+ *
+ */
+typedef struct control_header_struct {
+  uint16_t magic;           // OPENREMJAM_CONTROL_MAGIC
+  uint8_t version;          // OPENREMJAM_CONTROL_VERSION
+  ControlType type;
+  uint32_t seqno;           // chosen by the client, copied into the ack
+} control_header_t;
+
+typedef struct control_subscribe_struct {
+  control_header_t h;
+  uint32_t interval_ms;     // telemetry interval, at least OPENREMJAM_CONTROL_MIN_INTERVAL_MS, 0 ends the subscription
+} control_subscribe_t;
+
+typedef struct control_set_struct {
+  control_header_t h;
+  uint8_t queue;
+  ControlParam param;
+  uint16_t reserved;
+  int32_t value;
+} control_set_t;
+
+typedef struct control_connect_struct {
+  control_header_t h;
+  uint8_t queue;
+  uint8_t reserved;
+  uint16_t port;
+  uint32_t ip;              // IPv4 address, network byte order
+} control_connect_t;
+
+typedef struct control_ack_struct {
+  control_header_t h;       // seqno of the request
+  ControlType request;
+  ControlStatus status;
+  uint16_t reserved;
+} control_ack_t;
+
+/**
+ * @brief Telemetry snapshot of one connected queue
+ *
+ */
+typedef struct control_queue_struct {
+  uint32_t ip;              // IPv4 address of the remote host, network byte order (0: IPv6)
+  uint16_t port;
+  uint8_t queue;            // queue index
+  uint8_t flags;            // OPENREMJAM_CONTROL_FLAG_*
+  uint8_t queue_length;
+  uint8_t prefill;
+  uint8_t max_buffers;
+  uint8_t capacity;
+  int32_t gain;             // 1/1000
+  int32_t drift;            // resampler correction in 1/1000 ppm
+  uint32_t jitter;          // us, running average
+  uint32_t jitter_p99;      // us
+  uint32_t rtt;             // us, average
+  uint32_t buffering_delay; // us, average
+  uint32_t latency;         // us, average total latency
+  uint32_t early_packets;
+  uint32_t late_packets;
+  uint32_t recoveries_success;
+  uint32_t recoveries_failed;
+  uint32_t concealed_packets;
+  uint32_t fec_recovered_packets;
+  uint32_t rejected_packets;
+} control_queue_t;
+
+#define OPENREMJAM_CONTROL_FLAG_ADAPTIVE (1 << 0)
+#define OPENREMJAM_CONTROL_FLAG_DRIFT (1 << 1)
+#define OPENREMJAM_CONTROL_FLAG_ADPCM (1 << 2)
+
+typedef struct control_telemetry_struct {
+  control_header_t h;       // seqno counts the telemetry messages sent to this subscriber
+  uint32_t uptime_ms;
+  uint8_t queues;           // number of control_queue_t that follow (up to OPENREMJAM_CONTROL_QUEUES_PER_PACKET)
+  uint8_t more;             // 1: the snapshot continues in the next telemetry message (same seqno)
+  uint16_t reserved;
+} control_telemetry_t;
+
+static_assert(sizeof(control_header_t) == 8, "part of the control protocol");
+static_assert(sizeof(control_set_t) == 16, "part of the control protocol");
+static_assert(sizeof(control_connect_t) == 16, "part of the control protocol");
+static_assert(sizeof(control_ack_t) == 12, "part of the control protocol");
+static_assert(sizeof(control_queue_t) == 68, "part of the control protocol");
+static_assert(sizeof(control_telemetry_t) == 16, "part of the control protocol");
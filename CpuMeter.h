@@ -0,0 +1,102 @@
+#pragma once
+
+#define OPENREMJAM_CPU_WINDOW_MS (1000)                   // default: 1000 (CpuMeter averages the load of a loop() stage over this time)
+
+#include <Arduino.h>
+
+/**
+ * @brief Always-on CPU accounting of a stage that runs in loop(), the counterpart of AudioStream::processorUsage()
+ *        for code outside the audio interrupt. Each call is timed with the DWT cycle counter (two reads, no
+ *        division): the usage is the share of the CPU the stage took in the last complete window of
+ *        OPENREMJAM_CPU_WINDOW_MS, its peak is the highest window since resetMax(). The longest single call is kept
+ *        as well, it is what delays the other stages of loop(). Not interrupt safe: use from loop() only.
+ *
+ */
+class CpuMeter {
+  public:
+    CpuMeter() { reset(); }
+
+    /**
+     * @brief Start timing a call
+     *
+     * @return uint32_t cycle counter, pass it to stop()
+     */
+    static uint32_t start() { return ARM_DWT_CYCCNT; }
+
+    /**
+     * @brief Account a call (several stop() per call are fine, e.g. to leave out nested stages)
+     *
+     * @param start the value of start() at the beginning of the call
+     */
+    void stop(uint32_t start) {
+      uint32_t cycles = ARM_DWT_CYCCNT - start;
+      roll();
+      busy += cycles;
+      if (cycles > call_max) call_max = cycles;
+    }
+
+    /**
+     * @brief Get the usage in the last complete window
+     *
+     * @return float percent of the CPU
+     */
+    float getUsage() {
+      roll();
+      return usage;
+    }
+
+    /**
+     * @brief Get the highest usage of a window since resetMax()
+     *
+     * @return float percent of the CPU
+     */
+    float getUsageMax() {
+      roll();
+      return usage_max;
+    }
+
+    /**
+     * @brief Get the longest call since resetMax()
+     *
+     * @return float microseconds
+     */
+    float getCallMaxUs() { return call_max * (1e6f / F_CPU_ACTUAL); }
+
+    /**
+     * @brief Start over with the peak values (like AudioProcessorUsageMaxReset())
+     *
+     */
+    void resetMax() {
+      usage_max = usage;
+      call_max = 0;
+    }
+
+    /**
+     * @brief Clear everything and start a new window
+     *
+     */
+    void reset() {
+      window_start = millis();
+      busy = 0;
+      usage = 0;
+      usage_max = 0;
+      call_max = 0;
+    }
+
+  private:
+    // windows are timed with millis(): the 32 bit cycle counter wraps within seconds at 600 MHz
+    void roll() {
+      uint32_t elapsed = millis() - window_start;
+      if (elapsed < OPENREMJAM_CPU_WINDOW_MS) return;
+      usage = busy * 100.0f / ((float)elapsed * (F_CPU_ACTUAL / 1000));
+      if (usage > usage_max) usage_max = usage;
+      busy = 0;
+      window_start += elapsed;
+    }
+
+    uint32_t window_start;  // millis()
+    uint32_t busy;          // cycles in the current window
+    uint32_t call_max;      // cycles
+    float usage;
+    float usage_max;
+};
@@ -0,0 +1,58 @@
+#include "EventLog.h"
+#include <atomic>
+
+static_assert((OPENREMJAM_LOG_SIZE & (OPENREMJAM_LOG_SIZE - 1)) == 0, "OPENREMJAM_LOG_SIZE must be a power of two");
+
+EventLog::ring_t EventLog::rings[2];
+uint32_t EventLog::reported_dropped = 0;
+
+boolean EventLog::inInterrupt() {
+#if defined(__IMXRT1062__)
+    return (SCB_ICSR & 0x1ff) != 0; // VECTACTIVE: number of the active exception, 0 in thread mode
+#else
+    return false; // host build: update_all() runs in the caller's context
+#endif
+}
+
+void EventLog::write(const char *format, int32_t a, int32_t b, int32_t c) {
+    ring_t &r = rings[inInterrupt() ? 1 : 0];
+    uint32_t head = r.head;
+    if (head - r.tail >= OPENREMJAM_LOG_SIZE) {
+        r.dropped++;
+        return;
+    }
+    log_record_t &rec = r.records[head & (OPENREMJAM_LOG_SIZE - 1)];
+    rec.timestamp = micros();
+    rec.format = format;
+    rec.args[0] = a;
+    rec.args[1] = b;
+    rec.args[2] = c;
+    std::atomic_signal_fence(std::memory_order_release); // the record is complete before flush() can see it
+    r.head = head + 1;
+}
+
+void EventLog::flush() {
+    for (;;) {
+        // merge both rings by timestamp
+        ring_t *next = nullptr;
+        for (ring_t &r : rings) {
+            if (r.tail == r.head) continue;
+            if (!next || (int32_t)(r.records[r.tail & (OPENREMJAM_LOG_SIZE - 1)].timestamp -
+                                   next->records[next->tail & (OPENREMJAM_LOG_SIZE - 1)].timestamp) < 0) next = &r;
+        }
+        if (!next) break;
+        std::atomic_signal_fence(std::memory_order_acquire);
+        const log_record_t &rec = next->records[next->tail & (OPENREMJAM_LOG_SIZE - 1)];
+        Serial.printf("[%10lu us] ", rec.timestamp);
+        Serial.printf(rec.format, rec.args[0], rec.args[1], rec.args[2]);
+        Serial.println();
+        next->tail = next->tail + 1;
+    }
+    uint32_t dropped = getDropped();
+    if (dropped != reported_dropped) {
+        Serial.printf("WARNING: EventLog -- %lu records dropped\r\n", dropped - reported_dropped);
+        reported_dropped = dropped;
+    }
+}
+
+uint32_t EventLog::getDropped() { return rings[0].dropped + rings[1].dropped; }
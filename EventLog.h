@@ -0,0 +1,88 @@
+#pragma once
+
+#define OPENREMJAM_LOG_LEVEL (3)                          // default: 3 (0: off, 1: errors, 2: + warnings, 3: + state changes, 4: + debug, e.g. each concealed block)
+#define OPENREMJAM_LOG_SIZE (64)                          // default: 64 (records per ring, power of two)
+
+#include "Audio.h"
+
+/**
+ * @brief A deferred log record: the format string (a literal, only its address is stored) and up to three arguments
+ *
+ */
+typedef struct log_record_struct {
+  uint32_t timestamp;   // micros() when the record was written
+  const char *format;
+  int32_t args[3];
+} log_record_t;
+
+/**
+ * @brief Deferred logging for the audio and network paths. write() only copies a fixed-size record into a ring, it
+ *        never blocks on the serial port; loop() formats and prints the records later with flush().
+ *        There is one lock-free single-producer ring for the audio interrupt (update()) and one for loop(), so a
+ *        record written in loop() cannot be torn by the interrupt. Records that do not fit are dropped and counted.
+ *        Use the OPENREMJAM_LOG_* macros: logs above OPENREMJAM_LOG_LEVEL are removed at compile time.
+ *
+ */
+class EventLog {
+  public:
+
+    /**
+     * @brief Write a record (audio interrupt or loop())
+     *
+     * @param format printf format string literal, up to three int32_t arguments
+     * @param a first argument
+     * @param b second argument
+     * @param c third argument
+     */
+    static void write(const char *format, int32_t a = 0, int32_t b = 0, int32_t c = 0);
+
+    /**
+     * @brief Print all pending records, oldest first (loop() only)
+     *
+     */
+    static void flush();
+
+    /**
+     * @brief Get the count of records dropped because a ring was full
+     *
+     * @return uint32_t count
+     */
+    static uint32_t getDropped();
+
+  private:
+    typedef struct ring_struct {
+      log_record_t records[OPENREMJAM_LOG_SIZE];
+      volatile uint32_t head;   // written by the producer only
+      volatile uint32_t tail;   // written by flush() only
+      volatile uint32_t dropped;
+    } ring_t;
+
+    static ring_t rings[2];       // 0: loop(), 1: interrupt
+    static uint32_t reported_dropped;
+
+    static boolean inInterrupt();
+};
+
+#if OPENREMJAM_LOG_LEVEL >= 1
+#define OPENREMJAM_LOG_ERROR(...) EventLog::write(__VA_ARGS__)
+#else
+#define OPENREMJAM_LOG_ERROR(...) do {} while (0)
+#endif
+
+#if OPENREMJAM_LOG_LEVEL >= 2
+#define OPENREMJAM_LOG_WARNING(...) EventLog::write(__VA_ARGS__)
+#else
+#define OPENREMJAM_LOG_WARNING(...) do {} while (0)
+#endif
+
+#if OPENREMJAM_LOG_LEVEL >= 3
+#define OPENREMJAM_LOG_INFO(...) EventLog::write(__VA_ARGS__)
+#else
+#define OPENREMJAM_LOG_INFO(...) do {} while (0)
+#endif
+
+#if OPENREMJAM_LOG_LEVEL >= 4
+#define OPENREMJAM_LOG_DEBUG(...) EventLog::write(__VA_ARGS__)
+#else
+#define OPENREMJAM_LOG_DEBUG(...) do {} while (0)
+#endif
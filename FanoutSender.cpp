@@ -0,0 +1,101 @@
+#include "FanoutSender.h"
+
+FanoutSender::FanoutSender(QueueController &q) : qc(q), sock(FNET_NULL), group_sa{} {}
+
+void FanoutSender::begin(fnet_socket_t s) { sock = s; }
+
+void FanoutSender::send(uint8_t *buf, uint32_t size, Codec codec) {
+    if (sock == FNET_NULL) return;
+    uint32_t t0 = CpuMeter::start();
+    openremjam_header_t *h = (openremjam_header_t *)buf;
+    boolean server = qc.getServerMode();
+    boolean multicast = getMulticast() != IPAddress(0, 0, 0, 0);
+    boolean group = multicast && !server && codec == Codec::pcm; // the group carries PCM only
+    if (group) {
+        h->echo_timestamp = 0; // one packet for all remote hosts: nothing to echo
+        h->echo_delay = 0;
+        fnet_socket_sendto(sock, (fnet_uint8_t *)buf, size, 0, &group_sa, sizeof(group_sa));
+    }
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+        NetworkJitterBufferPlayQueue *q = qc.getQueue(i);
+        if (!q->getPort() || q->getSendCodec() != codec) continue;
+        // remote hosts the group reaches have got the packet already
+        if (group && isReachedByGroup(q)) continue;
+        // clients of a server receive their mix-minus (which contains our signal) instead
+        if (server && !q->isLoopback()) continue;
+        q->fillEcho(*h); // sendto() copies the packet, so the header can be changed for the next remote host
+        fnet_socket_sendto(sock, (fnet_uint8_t *)buf, size, 0, q->getSockaddrPtr(), sizeof(struct fnet_sockaddr));
+    }
+    cpu.stop(t0);
+}
+
+boolean FanoutSender::hasReceivers(Codec codec) {
+    boolean server = qc.getServerMode();
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+        NetworkJitterBufferPlayQueue *q = qc.getQueue(i);
+        if (!q->getPort() || q->getSendCodec() != codec) continue;
+        if (server && !q->isLoopback()) continue; // see send()
+        return true;
+    }
+    return false;
+}
+
+void FanoutSender::sendMixMinus() {
+    if (sock == FNET_NULL) return;
+    uint32_t t0 = CpuMeter::start();
+    MixMinusServer<OPENREMJAM_MAX_PEERS> *mm = qc.getMixMinus();
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+        uint8_t *buf;
+        uint32_t size;
+        while ((buf = mm->getPacket(i, size)) != nullptr) {
+            NetworkJitterBufferPlayQueue *q = qc.getQueue(i);
+            if (q->getPort()) {
+                q->fillEcho(*(openremjam_header_t *)buf);
+                fnet_socket_sendto(sock, (fnet_uint8_t *)buf, size, 0, q->getSockaddrPtr(), sizeof(struct fnet_sockaddr));
+            }
+            mm->releasePacket(i);
+        }
+    }
+    cpu.stop(t0);
+}
+
+boolean FanoutSender::setMulticast(IPAddress group) {
+    fnet_ip4_addr_t old_group = getMulticast();
+    if (old_group) {
+        changeMembership(old_group, false);
+        memset(&group_sa, 0, sizeof(group_sa));
+    }
+    if (group == IPAddress(0, 0, 0, 0)) return true;
+    if ((group[0] & 0xf0) != 224 || !changeMembership(group, true)) {
+        Serial.println("Warning: setMulticast() -- cannot join group!");
+        return false;
+    }
+    fnet_sockaddr_in *sa_ptr = (fnet_sockaddr_in *)&group_sa; // re-use this struct for IPv4 (it's comaptible!)
+    sa_ptr->sin_family = AF_INET;
+    sa_ptr->sin_port = fnet_htons(OPENREMJAM_DEFAULT_UDP_PORT);
+    sa_ptr->sin_addr.s_addr = group;
+    return true;
+}
+
+IPAddress FanoutSender::getMulticast() {
+    if (group_sa.sa_family != AF_INET) return IPAddress(0, 0, 0, 0);
+    return IPAddress(((fnet_sockaddr_in *)&group_sa)->sin_addr.s_addr);
+}
+
+boolean FanoutSender::isReachedByGroup(NetworkJitterBufferPlayQueue *q) {
+    // IPv4 hosts on our subnet that receive on the group's port, except ourselves (the group's echo of our own
+    // packets is dropped, see receivePackets())
+    struct fnet_sockaddr *sa = q->getSockaddrPtr();
+    if (q->isLoopback() || sa->sa_family != AF_INET || sa->sa_port != group_sa.sa_port) return false;
+    fnet_ip4_addr_t addr = ((fnet_sockaddr_in *)sa)->sin_addr.s_addr;
+    fnet_ip4_addr_t mask = Ethernet.subnetMask();
+    return ((addr ^ (fnet_ip4_addr_t)Ethernet.localIP()) & mask) == 0;
+}
+
+boolean FanoutSender::changeMembership(fnet_ip4_addr_t group, boolean join) {
+    if (sock == FNET_NULL) return false;
+    struct fnet_ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = group;
+    mreq.imr_interface = 0; // default interface
+    return fnet_socket_setopt(sock, IPPROTO_IP, join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq)) == FNET_OK;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "fnet.h"
+#include "NativeEthernet.h"
+#include "NativeEthernetUdp.h"
+#include "QueueController.h"
+#include "CpuMeter.h"
+
+/**
+ * @brief EthernetUDP that exposes its FNET socket, so FanoutSender sends from the local port we receive on
+ *        (remote hosts identify our queue by address and port)
+ *
+ */
+class FnetUDP : public EthernetUDP {
+  public:
+    /**
+     * @brief Get the FNET socket (valid after begin())
+     *
+     * @return fnet_socket_t socket
+     */
+    fnet_socket_t getSocket() { return Ethernet.socket_ptr[sockindex]; }
+};
+
+/**
+ * @brief Sends each packet to all connected remote hosts, from the packet buffer itself: one fnet_socket_sendto()
+ *        per queue with the queue's sockaddr (IPv4 or IPv6). In multicast mode, a single transmission to the group
+ *        replaces the PCM packets to the remote hosts it reaches: IPv4 hosts on our subnet that receive on
+ *        OPENREMJAM_DEFAULT_UDP_PORT (they are expected to have joined the same group). Their packets carry no
+ *        echo, so they cannot measure their round trip time to us. Everybody else (other subnets, IPv6, other ports,
+ *        IMA-ADPCM, loopback queues) is still sent to one by one. In server mode (QueueController::setServerMode()),
+ *        remote hosts get their mix-minus stream from sendMixMinus() instead, and send() reaches loopback queues only.
+ *
+ */
+class FanoutSender {
+  public:
+
+    /**
+     * @brief Construct a new FanoutSender object
+     *
+     * @param qc queues of the remote hosts
+     */
+    FanoutSender(QueueController &qc);
+
+    /**
+     * @brief Set the socket to send from
+     *
+     * @param s FNET UDP socket, see FnetUDP::getSocket()
+     */
+    void begin(fnet_socket_t s);
+
+    /**
+     * @brief Send a packet to all connected remote hosts that receive the given codec from us. The echo fields of
+     *        the header are filled in for each remote host (see NetworkJitterBufferPlayQueue::fillEcho()).
+     *
+     * @param buf packet, header followed by the payload
+     * @param size size in bytes
+     * @param codec codec of the packet, see NetworkJitterBufferPlayQueue::getSendCodec()
+     */
+    void send(uint8_t *buf, uint32_t size, Codec codec);
+
+    /**
+     * @brief Would send() reach any remote host with the given codec? Saves encoding packets nobody receives.
+     *
+     * @param codec codec of the packet, see NetworkJitterBufferPlayQueue::getSendCodec()
+     * @return boolean
+     */
+    boolean hasReceivers(Codec codec);
+
+    /**
+     * @brief Server mode: send each client the network blocks of its mix-minus stream that are ready (call from loop())
+     *
+     */
+    void sendMixMinus();
+
+    /**
+     * @brief Enable multicast: join the group (to receive) and send to it instead of to each remote host. Requires
+     *        FNET_CFG_MULTICAST and FNET_CFG_IGMP.
+     *
+     * @param group IPv4 multicast group, 0.0.0.0 disables multicast
+     * @return boolean false if the group is invalid or cannot be joined
+     */
+    boolean setMulticast(IPAddress group);
+
+    /**
+     * @brief Get the multicast group
+     *
+     * @return IPAddress group, 0.0.0.0 if multicast is disabled
+     */
+    IPAddress getMulticast();
+
+    /**
+     * @brief Get the CPU accounting of the send fan-out: send() and sendMixMinus(), including the mix-minus encoding
+     *
+     * @return CpuMeter&
+     */
+    CpuMeter &getCpu() { return cpu; }
+
+  private:
+    QueueController &qc;
+    fnet_socket_t sock;
+    struct fnet_sockaddr group_sa;  // multicast group and our port, all zero if multicast is disabled
+    CpuMeter cpu;
+
+    boolean isReachedByGroup(NetworkJitterBufferPlayQueue *q);
+    boolean changeMembership(fnet_ip4_addr_t group, boolean join);
+};
@@ -0,0 +1,38 @@
+#include "FecEncoder.h"
+
+static_assert(OPENREMJAM_SAMPLES_PER_NETWORK_BLOCK % 2 == 0, "parity is computed word by word");
+
+FecEncoder::FecEncoder() : parity{}, group(OPENREMJAM_FEC_GROUP), first(0), pending(0) {}
+
+boolean FecEncoder::setGroup(uint32_t k) {
+    if (k == 1 || k > OPENREMJAM_FEC_MAX_GROUP) return false;
+    group = k;
+    pending = 0;
+    return true;
+}
+
+uint32_t FecEncoder::getGroup() { return group; }
+
+boolean FecEncoder::add(const uint8_t *packet) {
+    if (!group) return false;
+    const uint32_t sample_bytes = OPENREMJAM_SAMPLES_PER_NETWORK_BLOCK * 2;
+    uint8_t *samples = (uint8_t *)parity + OPENREMJAM_HEADER_SIZE;
+    if (!pending) {
+        memcpy(samples, &packet[OPENREMJAM_HEADER_SIZE], sample_bytes);
+        first = ((const openremjam_header_t *)packet)->seqno;
+    } else {
+        xorInto(samples, &packet[OPENREMJAM_HEADER_SIZE], sample_bytes);
+    }
+    if (++pending < group) return false;
+    pending = 0;
+    fillHeader(*(openremjam_header_t *)parity, PacketType::parity, Codec::pcm, first, OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK, group);
+    return true;
+}
+
+uint8_t *FecEncoder::getParityPacket() { return (uint8_t *)parity; }
+
+void FecEncoder::xorInto(void *dst, const void *src, uint32_t bytes) {
+    uint32_t *d = (uint32_t *)dst;
+    const uint32_t *s = (const uint32_t *)src;
+    for (uint32_t i = 0; i < bytes / 4; ++i) d[i] ^= s[i];
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#define OPENREMJAM_FEC_GROUP (0)                          // default: 0 (network blocks per XOR parity packet, 0: no parity packets are sent)
+#define OPENREMJAM_FEC_MAX_GROUP (16)                     // default: 16 (largest group a receiver rebuilds from)
+
+#include "NetworkJitterBufferPlayQueue.h"
+
+/**
+ * @brief Forward error correction for the sender: after every group of k network blocks, a parity packet carries the
+ *        XOR of their samples (header: PacketType::parity, seqno of the first block, fec_group k). A receiver that
+ *        misses exactly one block of the group rebuilds it from the parity packet and the other k-1 blocks, see
+ *        NetworkJitterBufferPlayQueue::commitPayload().
+ *
+ */
+class FecEncoder {
+  public:
+
+    /**
+     * @brief Construct a new FecEncoder object
+     *
+     */
+    FecEncoder(void);
+
+    /**
+     * @brief Set the number of network blocks per parity packet. Costs 1/k extra bandwidth.
+     *
+     * @param k group size [2..OPENREMJAM_FEC_MAX_GROUP], 0 disables FEC
+     * @return boolean false if k is invalid
+     */
+    boolean setGroup(uint32_t k);
+
+    /**
+     * @brief Get the number of network blocks per parity packet
+     *
+     * @return uint32_t group size, 0: FEC disabled
+     */
+    uint32_t getGroup();
+
+    /**
+     * @brief Add a network block that is being sent
+     *
+     * @param packet PCM packet of OPENREMJAM_MONO_PACKET_SIZE bytes, header followed by samples
+     * @return boolean true if the group is complete and the parity packet has to be sent now
+     */
+    boolean add(const uint8_t *packet);
+
+    /**
+     * @brief Get the parity packet of the last complete group
+     *
+     * @return uint8_t* packet of OPENREMJAM_MONO_PACKET_SIZE bytes
+     */
+    uint8_t *getParityPacket();
+
+    /**
+     * @brief XOR src into dst, word by word
+     *
+     * @param dst destination, 32 bit aligned
+     * @param src source, 32 bit aligned
+     * @param bytes number of bytes, a multiple of 4
+     */
+    static void xorInto(void *dst, const void *src, uint32_t bytes);
+
+  private:
+    uint32_t parity[OPENREMJAM_MONO_PACKET_SIZE / 4]; // header, samples
+    uint32_t group;
+    uint32_t first;     // seqno of the first block of the current group
+    uint32_t pending;   // blocks added to the current group
+};
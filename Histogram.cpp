@@ -0,0 +1,34 @@
+#include "Histogram.h"
+
+Histogram::Histogram(uint32_t w) : width(w), count(0), buckets{} {}
+
+void Histogram::reset() {
+    count = 0;
+    memset(buckets, 0, sizeof(buckets));
+}
+
+uint32_t Histogram::getPercentile(float p) const {
+    if (!count) return 0;
+    uint32_t rank = (uint32_t)(p * count + 0.999f); // values at or below the percentile, rounded up
+    if (rank < 1) rank = 1;
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < OPENREMJAM_HISTOGRAM_BUCKETS - 1; ++i) {
+        sum += buckets[i];
+        if (sum >= rank) return (i + 1) * width - 1;
+    }
+    return (OPENREMJAM_HISTOGRAM_BUCKETS - 1) * width;
+}
+
+void Histogram::print(const char *title, const char *unit) const {
+    Serial.printf("%s (%lu values):\r\n", title, count);
+    for (uint32_t i = 0; i < OPENREMJAM_HISTOGRAM_BUCKETS; ++i) {
+        if (!buckets[i]) continue;
+        if (i == OPENREMJAM_HISTOGRAM_BUCKETS - 1) {
+            Serial.printf("  >= %6lu %s: %8lu (%5.1f%%)\r\n", i * width, unit, buckets[i], 100.0f * buckets[i] / count);
+        } else if (width == 1) {
+            Serial.printf("     %6lu %s: %8lu (%5.1f%%)\r\n", i, unit, buckets[i], 100.0f * buckets[i] / count);
+        } else {
+            Serial.printf("  %6lu...%6lu %s: %8lu (%5.1f%%)\r\n", i * width, (i + 1) * width - 1, unit, buckets[i], 100.0f * buckets[i] / count);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#define OPENREMJAM_HISTOGRAM_BUCKETS (32)                 // default: 32 (buckets per histogram, the last one also counts all larger values)
+
+#include "Audio.h"
+
+/**
+ * @brief Histogram with fixed-width buckets. add() is O(1), so it can be called per packet or per audio block;
+ *        percentiles are read from the bucket counts.
+ *
+ */
+class Histogram {
+  public:
+
+    /**
+     * @brief Construct a new, empty Histogram object
+     *
+     * @param width bucket width: bucket i counts the values i * width ... (i + 1) * width - 1
+     */
+    Histogram(uint32_t width);
+
+    /**
+     * @brief Forget all values
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Add a value
+     *
+     * @param v value
+     */
+    void add(uint32_t v) {
+      uint32_t i = v / width;
+      buckets[i < OPENREMJAM_HISTOGRAM_BUCKETS ? i : OPENREMJAM_HISTOGRAM_BUCKETS - 1]++;
+      count++;
+    }
+
+    /**
+     * @brief Get the number of values
+     *
+     * @return uint32_t count
+     */
+    uint32_t getCount() const { return count; }
+
+    /**
+     * @brief Get the value below which the given fraction of the values lies
+     *
+     * @param p fraction, e.g. 0.99 for the 99th percentile
+     * @return uint32_t largest value of the bucket that contains the percentile (the last bucket: its smallest
+     *         value, the percentile is at least that), 0 if there are no values
+     */
+    uint32_t getPercentile(float p) const;
+
+    /**
+     * @brief Print the non-empty buckets
+     *
+     * @param title heading
+     * @param unit unit of the values
+     */
+    void print(const char *title, const char *unit) const;
+
+  private:
+    uint32_t width;
+    uint32_t count;
+    uint32_t buckets[OPENREMJAM_HISTOGRAM_BUCKETS];
+};
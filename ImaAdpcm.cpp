@@ -0,0 +1,84 @@
+#include "ImaAdpcm.h"
+
+static const int8_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+int16_t ImaAdpcm::decodeSample(uint8_t code, int32_t &predictor, int32_t &index) {
+    int32_t step = step_table[index];
+    int32_t diff = step >> 3;
+    if (code & 4) diff += step;
+    if (code & 2) diff += step >> 1;
+    if (code & 1) diff += step >> 2;
+    predictor += (code & 8) ? -diff : diff;
+    if (predictor > 32767) predictor = 32767;
+    else if (predictor < -32768) predictor = -32768;
+    index += index_table[code];
+    if (index < 0) index = 0;
+    else if (index > 88) index = 88;
+    return predictor;
+}
+
+uint8_t ImaAdpcm::encodeSample(int32_t sample, int32_t &predictor, int32_t &index) {
+    int32_t step = step_table[index];
+    int32_t diff = sample - predictor;
+    uint8_t code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+    }
+    if (diff >= step >> 1) {
+        code |= 2;
+        diff -= step >> 1;
+    }
+    if (diff >= step >> 2) code |= 1;
+    decodeSample(code, predictor, index); // track the decoder, so the quantization error does not accumulate
+    return code;
+}
+
+void ImaAdpcm::encode(const int16_t *in, uint32_t n, uint8_t *out, ima_adpcm_state_t &state) {
+    int32_t predictor = state.predictor;
+    int32_t index = state.index;
+    out[0] = predictor & 0xff;
+    out[1] = (predictor >> 8) & 0xff;
+    out[2] = index;
+    out[3] = 0;
+    out += OPENREMJAM_ADPCM_HEADER_SIZE;
+    for (uint32_t i = 0; i < n; i += 2) {
+        uint8_t lo = encodeSample(in[i], predictor, index);
+        uint8_t hi = encodeSample(in[i + 1], predictor, index);
+        out[i >> 1] = lo | (hi << 4);
+    }
+    state.predictor = predictor;
+    state.index = index;
+}
+
+void ImaAdpcm::decode(const uint8_t *in, uint32_t n, int16_t *out) {
+    int32_t predictor = (int16_t)(in[0] | (in[1] << 8));
+    int32_t index = in[2] > 88 ? 88 : in[2];
+    in += OPENREMJAM_ADPCM_HEADER_SIZE;
+    for (uint32_t i = 0; i < n; i += 2) {
+        uint8_t codes = in[i >> 1];
+        int16_t lo = decodeSample(codes & 0x0f, predictor, index);
+        int16_t hi = decodeSample(codes >> 4, predictor, index);
+        out[i] = lo;
+        out[i + 1] = hi;
+    }
+}
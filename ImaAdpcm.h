@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Audio.h"
+
+// DO NOT CHANGE THESE:
+#define OPENREMJAM_ADPCM_HEADER_SIZE (4)                  // predictor (int16), step index (uint8), reserved (uint8)
+
+/**
+ * @brief IMA-ADPCM coder state: predicted sample and index into the step size table
+ *
+ */
+typedef struct ima_adpcm_state_struct {
+  int16_t predictor;
+  uint8_t index;
+} ima_adpcm_state_t;
+
+/**
+ * @brief IMA-ADPCM codec (4 bit per sample, no lookahead). Each encoded block starts with the coder state, so a block
+ *        decodes without its predecessors and a lost packet does not affect the next one.
+ *        Encoded block: OPENREMJAM_ADPCM_HEADER_SIZE bytes header, then n/2 bytes, two samples per byte (first sample in
+ *        the low nibble).
+ *
+ */
+class ImaAdpcm {
+  public:
+
+    /**
+     * @brief Encode a block of samples
+     *
+     * @param in samples
+     * @param n number of samples, even
+     * @param out encoded block (OPENREMJAM_ADPCM_HEADER_SIZE + n/2 bytes)
+     * @param state coder state, carried over from the previous block of the stream
+     */
+    static void encode(const int16_t *in, uint32_t n, uint8_t *out, ima_adpcm_state_t &state);
+
+    /**
+     * @brief Decode a block of samples. out may overlap the end of in: out[i] is written after the nibbles of
+     *        sample i have been read, so the block can be decoded in place if it is stored at the end of a buffer
+     *        of at least 2 * n + 4 bytes that starts at out.
+     *
+     * @param in encoded block (OPENREMJAM_ADPCM_HEADER_SIZE + n/2 bytes)
+     * @param n number of samples, even
+     * @param out samples
+     */
+    static void decode(const uint8_t *in, uint32_t n, int16_t *out);
+
+  private:
+    static uint8_t encodeSample(int32_t sample, int32_t &predictor, int32_t &index);
+    static int16_t decodeSample(uint8_t code, int32_t &predictor, int32_t &index);
+};
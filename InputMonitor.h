@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Audio.h"
+
+/**
+ * @brief Counts the audio blocks of our input, so input that never reaches the network is visible. Connect it to the
+ *        output that feeds the AudioRecordQueue; it passes nothing on.
+ *        An audio cycle without a block means the input stream got no audio memory (getMissing()). The blocks
+ *        counted here minus those loop() has read and those still waiting in the AudioRecordQueue are the blocks the
+ *        record queue dropped because loop() stalled longer than its backlog (see OPENREMJAM_LOOP_STALL_MAX_US).
+ *        Read both counters with AudioNoInterrupts(), together with AudioRecordQueue::available().
+ *
+ */
+class InputMonitor : public AudioStream {
+  public:
+    InputMonitor(void) : AudioStream(1, inputQueueArray), blocks(0), missing(0) {}
+
+    /**
+     * @brief Get the number of blocks received since startup
+     *
+     * @return uint32_t count
+     */
+    uint32_t getBlocks() { return blocks; }
+
+    /**
+     * @brief Get the number of audio cycles without a block since startup
+     *
+     * @return uint32_t count
+     */
+    uint32_t getMissing() { return missing; }
+
+    virtual void update(void) {
+      audio_block_t *block = receiveReadOnly(0);
+      if (!block) {
+        missing++;
+        return;
+      }
+      blocks++;
+      release(block);
+    }
+
+  private:
+    audio_block_t *inputQueueArray[1];
+    volatile uint32_t blocks;
+    volatile uint32_t missing;
+};
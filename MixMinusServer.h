@@ -0,0 +1,202 @@
+#pragma once
+
+#define OPENREMJAM_MIX_MINUS_SLOTS (2)                    // default: 2 (network blocks per client waiting for loop() to send them, power of two)
+
+#include <atomic>
+#include "Audio.h"
+#include "NetworkJitterBufferPlayQueue.h"
+#include "AudioMixerMulti.h"
+
+/**
+ * @brief Network blocks of one client's mix-minus: written by update(), sent by loop()
+ *
+ */
+typedef struct mix_minus_client_struct {
+  uint8_t packet[OPENREMJAM_MIX_MINUS_SLOTS][OPENREMJAM_MONO_PACKET_SIZE] __attribute__((aligned(4))); // header + PCM samples
+  volatile uint32_t written;        // network blocks completed by update()
+  volatile uint32_t read;           // network blocks sent by loop()
+  boolean filling;                  // update() is writing packet[written % OPENREMJAM_MIX_MINUS_SLOTS]
+  ima_adpcm_state_t adpcm_state;    // for clients that receive IMA-ADPCM
+} mix_minus_client_t;
+
+/**
+ * @brief Relay ("server") mode: the queues of all clients feed this stream, and each client gets back one stream, the
+ *        mix of everybody else (mix-minus). Instead of a full mesh, where every device sends to and receives from
+ *        every other device, each client sends one stream to the server and receives one.
+ *        The sum of all inputs is computed once per audio block, then each client's own input is subtracted again
+ *        (mixMinusSaturating()), so the cost is O(N) instead of O(N^2). Loopback queues are inputs (the server's own
+ *        signal) but not clients. Gains are those of the mixer (QueueController::setGain()).
+ *        update() writes complete network blocks (header and PCM samples) into a small ring per client; loop()
+ *        sends them with getPacket()/releasePacket() (see FanoutSender::sendMixMinus()).
+ *
+ * @tparam N number of inputs (queues)
+ */
+template <int N>
+class MixMinusServer : public AudioStream {
+  public:
+    static_assert((OPENREMJAM_MIX_MINUS_SLOTS & (OPENREMJAM_MIX_MINUS_SLOTS - 1)) == 0, "OPENREMJAM_MIX_MINUS_SLOTS must be a power of two");
+
+    /**
+     * @brief Construct a new MixMinusServer object (disabled)
+     *
+     */
+    MixMinusServer(void) : AudioStream(N, inputQueueArray), queue(nullptr), enabled(false), subindex(0), seqno(0), dropped(0) {
+      for (int i = 0; i < N; i++) {
+        multiplier[i] = 65536;
+        client[i].written = 0;
+        client[i].read = 0;
+        client[i].filling = false;
+        client[i].adpcm_state = {0, 0};
+      }
+    }
+
+    /**
+     * @brief Set the queues connected to the inputs (before setEnabled())
+     *
+     * @param queues N queue pointers, tell which inputs are clients
+     */
+    void begin(NetworkJitterBufferPlayQueue **queues) { queue = queues; }
+
+    /**
+     * @brief Set the gain of an input (like AudioMixer4::gain)
+     *
+     * @param channel input [0..N-1]
+     * @param gain -32767.0...32767.0
+     */
+    void gain(unsigned int channel, float gain) {
+      if (channel >= N) return;
+      if (gain > 32767.0f) gain = 32767.0f;
+      else if (gain < -32767.0f) gain = -32767.0f;
+      multiplier[channel] = gain * 65536.0f;
+    }
+
+    /**
+     * @brief Start or stop producing mix-minus streams. Pending network blocks are discarded.
+     *
+     * @param val true: server mode
+     */
+    void setEnabled(boolean val) {
+      if (!queue) return;
+      AudioNoInterrupts();
+      enabled = val;
+      subindex = 0;
+      for (int i = 0; i < N; i++) {
+        client[i].filling = false;
+        client[i].read = client[i].written;
+      }
+      AudioInterrupts();
+    }
+
+    /**
+     * @brief Is server mode enabled?
+     *
+     * @return boolean
+     */
+    boolean getEnabled() { return enabled; }
+
+    /**
+     * @brief Get the oldest network block of a client that has not been sent yet (call from loop()). The header is
+     *        filled in except for the echo fields; the payload is encoded with the client's send codec.
+     *
+     * @param i queue index of the client [0..N-1]
+     * @param size returns the packet size in bytes
+     * @return uint8_t* packet, nullptr if there is none. Valid until releasePacket().
+     */
+    uint8_t *getPacket(int i, uint32_t &size) {
+      if (i < 0 || i >= N) return nullptr;
+      mix_minus_client_t &c = client[i];
+      if (c.read == c.written) return nullptr;
+      std::atomic_signal_fence(std::memory_order_acquire); // read the packet after written
+      uint8_t *p = c.packet[c.read & (OPENREMJAM_MIX_MINUS_SLOTS - 1)];
+      if (queue[i]->getSendCodec() == Codec::adpcm) {
+        memcpy(adpcm_packet, p, OPENREMJAM_HEADER_SIZE);
+        ((openremjam_header_t *)adpcm_packet)->codec = Codec::adpcm;
+        ImaAdpcm::encode((int16_t *)&p[OPENREMJAM_HEADER_SIZE], OPENREMJAM_SAMPLES_PER_NETWORK_BLOCK,
+                         &adpcm_packet[OPENREMJAM_HEADER_SIZE], c.adpcm_state);
+        size = OPENREMJAM_MONO_ADPCM_PACKET_SIZE;
+        return adpcm_packet;
+      }
+      size = OPENREMJAM_MONO_PACKET_SIZE;
+      return p;
+    }
+
+    /**
+     * @brief Hand the packet of getPacket() back to update()
+     *
+     * @param i queue index of the client [0..N-1]
+     */
+    void releasePacket(int i) {
+      if (i < 0 || i >= N || client[i].read == client[i].written) return;
+      std::atomic_signal_fence(std::memory_order_release); // done with the packet before update() may reuse it
+      client[i].read = client[i].read + 1;
+    }
+
+    /**
+     * @brief Number of network blocks that were not produced because loop() had not sent the previous ones
+     *
+     * @return uint32_t
+     */
+    uint32_t getDroppedPackets() { return dropped; }
+
+    virtual void update(void) {
+      audio_block_t *block[N];
+      const int16_t *data[N];
+      int32_t mult[N];
+      uint32_t n = 0;
+      for (int i = 0; i < N; i++) {
+        block[i] = receiveReadOnly(i);
+        if (block[i] && multiplier[i]) {
+          data[n] = block[i]->data;
+          mult[n] = multiplier[i];
+          n++;
+        }
+      }
+      if (enabled) {
+        int32_t acc[AUDIO_BLOCK_SAMPLES];
+        mixAccumulate(acc, data, mult, n);
+        for (int i = 0; i < N; i++) {
+          mix_minus_client_t &c = client[i];
+          if (!queue[i]->getPort() || queue[i]->isLoopback()) {
+            c.filling = false;
+            continue;
+          }
+          if (subindex == 0) {
+            // a client starts with a whole network block
+            c.filling = c.written - c.read < OPENREMJAM_MIX_MINUS_SLOTS;
+            if (!c.filling) {
+              dropped++;
+              OPENREMJAM_LOG_WARNING("Mix-minus: queue %d: network block %lu dropped, loop() did not send in time", i, seqno);
+            }
+          }
+          if (!c.filling) continue;
+          uint8_t *p = c.packet[c.written & (OPENREMJAM_MIX_MINUS_SLOTS - 1)];
+          mixMinusSaturating((int16_t *)&p[OPENREMJAM_HEADER_SIZE] + subindex * AUDIO_BLOCK_SAMPLES, acc,
+                             block[i] ? block[i]->data : nullptr, multiplier[i]);
+          if (subindex == OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK - 1) {
+            fillHeader(*(openremjam_header_t *)p, PacketType::audio, Codec::pcm, seqno, OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK, 0);
+            std::atomic_signal_fence(std::memory_order_release); // publish the packet before written
+            c.written = c.written + 1;
+            c.filling = false;
+          }
+        }
+        if (++subindex == OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK) {
+          subindex = 0;
+          seqno++;
+        }
+      }
+      for (int i = 0; i < N; i++) {
+        if (block[i]) release(block[i]);
+      }
+    }
+
+  private:
+    NetworkJitterBufferPlayQueue **queue;
+    volatile boolean enabled;
+    uint32_t subindex;          // audio block within the network block being written
+    uint32_t seqno;             // one sequence for all clients
+    volatile uint32_t dropped;
+    int32_t multiplier[N];
+    mix_minus_client_t client[N];
+    uint8_t adpcm_packet[OPENREMJAM_MONO_ADPCM_PACKET_SIZE] __attribute__((aligned(4))); // loop() only
+    audio_block_t *inputQueueArray[N];
+};
@@ -0,0 +1,60 @@
+#include "NetworkBlockPool.h"
+#include "QueueController.h"
+
+#if OPENREMJAM_BLOCK_POOL_MEMORY == 2
+#define BLOCK_POOL_SECTION EXTMEM
+#define BLOCK_POOL_SECTION_NAME "EXTMEM"
+#elif OPENREMJAM_BLOCK_POOL_MEMORY == 1
+#define BLOCK_POOL_SECTION DMAMEM
+#define BLOCK_POOL_SECTION_NAME "DMAMEM"
+#else
+#define BLOCK_POOL_SECTION
+#define BLOCK_POOL_SECTION_NAME "RAM1"
+#endif
+
+// slot layout like NetworkJitterBufferRing: samples, followed by network_block_info_t
+static const uint32_t slot_words = OPENREMJAM_SAMPLES_PER_NETWORK_BLOCK + sizeof(network_block_info_t) / sizeof(int16_t);
+
+// DMAMEM and EXTMEM are not initialized at startup: a queue clears the slots it borrows. Slots start on cache lines
+static int16_t storage[OPENREMJAM_BLOCK_POOL_SLOTS * slot_words] BLOCK_POOL_SECTION __attribute__((aligned(32)));
+
+int16_t *NetworkBlockPool::free_slots[OPENREMJAM_BLOCK_POOL_SLOTS];
+uint32_t NetworkBlockPool::free_count = 0;
+uint32_t NetworkBlockPool::free_min = OPENREMJAM_BLOCK_POOL_SLOTS;
+boolean NetworkBlockPool::initialized = false;
+
+void NetworkBlockPool::begin() {
+    // on first use, so the pool needs no call from setup()
+    for (uint32_t i = 0; i < OPENREMJAM_BLOCK_POOL_SLOTS; ++i) free_slots[i] = &storage[i * slot_words];
+    free_count = OPENREMJAM_BLOCK_POOL_SLOTS;
+    initialized = true;
+}
+
+boolean NetworkBlockPool::allocate(int16_t **slots, uint32_t n) {
+    if (!initialized) begin();
+    if (n > free_count) return false;
+    for (uint32_t i = 0; i < n; ++i) slots[i] = free_slots[--free_count];
+    if (free_count < free_min) free_min = free_count;
+    return true;
+}
+
+void NetworkBlockPool::release(int16_t **slots, uint32_t n) {
+    for (uint32_t i = 0; i < n; ++i) {
+        if (slots[i]) free_slots[free_count++] = slots[i];
+        slots[i] = nullptr;
+    }
+}
+
+uint32_t NetworkBlockPool::getSize() { return OPENREMJAM_BLOCK_POOL_SLOTS; }
+
+uint32_t NetworkBlockPool::getFree() {
+    if (!initialized) begin();
+    return free_count;
+}
+
+uint32_t NetworkBlockPool::getFreeMin() { return free_min; }
+
+void NetworkBlockPool::printInfo() {
+    Serial.printf("Block pool: %lu/%lu slots free (min. %lu), %lu bytes each, in " BLOCK_POOL_SECTION_NAME "\r\n",
+                  getFree(), getSize(), getFreeMin(), (uint32_t)(slot_words * sizeof(int16_t)));
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#define OPENREMJAM_BLOCK_POOL_SLOTS (OPENREMJAM_MAX_PEERS * (OPENREMJAM_PLAY_QUEUE_SIZE + 1)) // default: OPENREMJAM_MAX_PEERS * (OPENREMJAM_PLAY_QUEUE_SIZE + 1) (network blocks shared by the pooled queues, a connected queue borrows capacity + 1)
+#define OPENREMJAM_BLOCK_POOL_MEMORY (1)                  // default: 1 (placement of the pool: 0 RAM1 (tightly coupled), 1 DMAMEM (RAM2), 2 EXTMEM (PSRAM, Teensy 4.1 with a PSRAM chip))
+
+#include <Arduino.h>
+
+/**
+ * @brief Fixed-size pool of network block slots, shared by the pooled play queues (NetworkJitterBufferPooledRing):
+ *        a queue borrows its slots when it leaves state stopped and returns them when it stops, so memory is only
+ *        taken by connected queues, and a deep queue for a distant peer takes what the idle ones leave.
+ *        A slot holds the samples of one network block of OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK audio blocks,
+ *        followed by network_block_info_t. The slots are placed by OPENREMJAM_BLOCK_POOL_MEMORY; the queues (ring of
+ *        slot pointers, state) stay in RAM1, and the slot that is being played is read once per audio block, so it
+ *        stays in the data cache. Not interrupt safe: use from loop() only.
+ *
+ */
+class NetworkBlockPool {
+  public:
+
+    /**
+     * @brief Borrow slots, all or none
+     *
+     * @param slots receives n slot pointers
+     * @param n number of slots
+     * @return boolean false if fewer than n slots are free
+     */
+    static boolean allocate(int16_t **slots, uint32_t n);
+
+    /**
+     * @brief Return slots
+     *
+     * @param slots n slot pointers from allocate()
+     * @param n number of slots
+     */
+    static void release(int16_t **slots, uint32_t n);
+
+    /**
+     * @brief Get the number of slots of the pool
+     *
+     * @return uint32_t OPENREMJAM_BLOCK_POOL_SLOTS
+     */
+    static uint32_t getSize();
+
+    /**
+     * @brief Get the number of free slots
+     *
+     * @return uint32_t
+     */
+    static uint32_t getFree();
+
+    /**
+     * @brief Get the lowest number of free slots so far
+     *
+     * @return uint32_t
+     */
+    static uint32_t getFreeMin();
+
+    /**
+     * @brief Print size, placement and usage via Serial
+     *
+     */
+    static void printInfo();
+
+  private:
+    static int16_t *free_slots[];
+    static uint32_t free_count;
+    static uint32_t free_min;
+    static boolean initialized;
+
+    static void begin();
+};
@@ -1,9 +1,48 @@
 #include "NetworkJitterBufferPlayQueue.h"
+#include "FecEncoder.h"
+
+NetworkJitterBufferPlayQueue::NetworkJitterBufferPlayQueue(uint32_t capacity, uint32_t blocks, uint32_t max_cap)
+    : AudioStream(0, NULL), state(State::stopped), sa{AF_INET, 0, 0, {}}, send_codec(Codec::pcm), queue(nullptr), spare(nullptr),
+      capacity_mask(capacity - 1), max_capacity(max_cap ? max_cap : capacity), blocks_per_packet(blocks), samples_per_packet(blocks * AUDIO_BLOCK_SAMPLES),
+      packet_duration_us(blocks * AUDIO_BLOCK_SAMPLES * 1000000 / 44100), max_buffers(capacity < 7 ? capacity : 7),
+      prefill(capacity < 7 ? capacity / 2 : 3), free_head(0), used_tail(0), subindex(0), read_index(0), read_frac(0), count(0), late_packets(),
+      early_packets(0), recoveries_success(0), recoveries_failed(0), concealed_packets(0), fec_recovered_packets(0), rejected_packets(0), statistics_due(false), recoveryStart(0), echo_timestamp(0),
+      echo_received(0), one_way_delay(0), rtt(), buffering_delay(), latency(), histograms(), adaptive(false),
+      adaptive_max_event_rate(OPENREMJAM_ADAPTIVE_MAX_EVENT_RATE), jitter(0), last_arrival(0), last_arrival_seqno(0),
+      last_arrival_valid(false), depth_margin(0), window_blocks(0), window_events(0), window_min_length(0),
+      quiet_windows(0), drift_compensation(true), step_delta(0), level_avg(0), level_setpoint(0), drift_integral(0),
+      settle_packets(0), plc(), plc_active(false) {}
+
+void NetworkJitterBufferPlayQueue::setStorage(int16_t * storage, int16_t ** slots) {
+    // slot layout: samples, followed by network_block_info_t
+    const uint32_t slot_words = samples_per_packet + sizeof(network_block_info_t) / sizeof(int16_t);
+    memset(storage, 0, (max_capacity + 1) * slot_words * sizeof(int16_t));
+    for (uint32_t i = 0; i < max_capacity; ++i) {
+        slots[i] = &storage[i * slot_words];
+    }
+    queue = slots;
+    spare = &storage[max_capacity * slot_words];
+}
+
+void NetworkJitterBufferPlayQueue::attachSlots(int16_t ** slots) {
+    const uint32_t slot_words = samples_per_packet + sizeof(network_block_info_t) / sizeof(int16_t);
+    for (uint32_t i = 0; i <= capacity_mask + 1; ++i) {
+        memset(slots[i], 0, slot_words * sizeof(int16_t));
+    }
+    queue = slots;
+    spare = slots[capacity_mask + 1];
+    free_head = 0;
+    used_tail = 0;
+}
 
-NetworkJitterBufferPlayQueue::NetworkJitterBufferPlayQueue()
-    : AudioStream(0, NULL), state(State::stopped), sa{AF_INET, 0, 0, {}}, queue{},  max_buffers{7},
-      prefill(3), free_head(0), used_tail(0), subindex(0), count(0), late_packets(),
-      early_packets(0), recoveries_success(0), recoveries_failed(0), recoveryStart(0) {}
+int16_t **NetworkJitterBufferPlayQueue::detachSlots() {
+    // the receive buffer may have been swapped with any slot: hand back whatever the ring holds now
+    int16_t **slots = queue;
+    slots[capacity_mask + 1] = spare;
+    queue = nullptr;
+    spare = nullptr;
+    return slots;
+}
 
 void NetworkJitterBufferPlayQueue::setIPv4(fnet_ip4_addr_t a) {
     fnet_sockaddr_in* sa_ptr = (fnet_sockaddr_in*) &sa; // re-use this struct for IPv4 (it's comaptible!)   
@@ -27,13 +66,16 @@ IPAddress NetworkJitterBufferPlayQueue::getIP() {
     return IPAddress(a);
 }
 
-void NetworkJitterBufferPlayQueue::setSockaddr(struct fnet_sockaddr &a) {
+boolean NetworkJitterBufferPlayQueue::setSockaddr(struct fnet_sockaddr &a) {
     sa = a;
     if (!getPort()) {
         switchState(State::stopped);
-    } else {
-        switchState(State::syncing);
+        return true;
     }
+    switchState(State::syncing);
+    if (state != State::stopped) return true;
+    sa.sa_port = 0; // no slots: a queue with a port must be able to receive
+    return false;
 }
 
 struct fnet_sockaddr *NetworkJitterBufferPlayQueue::getSockaddrPtr() {
@@ -52,13 +94,20 @@ fnet_ip4_addr_t *NetworkJitterBufferPlayQueue::getIP4Ptr() {
 
 boolean NetworkJitterBufferPlayQueue::hasIP6() { return sa.sa_family==AF_INET6;}
 
-void NetworkJitterBufferPlayQueue::setPort(uint16_t p) {
+boolean NetworkJitterBufferPlayQueue::isLoopback() { return !hasIP6() && getIP()[0] == 127; }
+
+boolean NetworkJitterBufferPlayQueue::setPort(uint16_t p) {
     sa.sa_port = fnet_htons(p);
-    if (p) {
-        switchState(State::syncing);
-    } else {
+    echo_timestamp = 0; // a new remote host: nothing to echo yet
+    one_way_delay = 0;
+    if (!p) {
         switchState(State::stopped);
+        return true;
     }
+    switchState(State::syncing);
+    if (state != State::stopped) return true;
+    sa.sa_port = 0; // no slots: a queue with a port must be able to receive
+    return false;
 }
 
 uint16_t NetworkJitterBufferPlayQueue::getPort() {
@@ -73,11 +122,56 @@ int32_t NetworkJitterBufferPlayQueue::getQueueLength() {
     //          size      6
     // used_tail=2, free_head=2 -> 0 (empty, zeroed blocks will be played)
     // used_tail=2, free_head=3  -> 1 (one network buffer is being played)
-    // used_tail=5, free_head=2  -> 3 (2 + 6 - 5)
-    if (free_head >= used_tail)
-        return (free_head - used_tail);
-    else
-        return (free_head + max_buffers - used_tail);
+    // used_tail=5, free_head=2  -> 3 (2 + 8 - 5, capacity 8)
+    return (free_head - used_tail) & capacity_mask;
+}
+
+uint32_t NetworkJitterBufferPlayQueue::getLatePackets() { return late_packets; }
+
+uint32_t NetworkJitterBufferPlayQueue::getEarlyPackets() { return early_packets; }
+
+uint32_t NetworkJitterBufferPlayQueue::getRecoveriesSuccess() { return recoveries_success; }
+
+uint32_t NetworkJitterBufferPlayQueue::getRecoveriesFailed() { return recoveries_failed; }
+
+uint32_t NetworkJitterBufferPlayQueue::getConcealedPackets() { return concealed_packets; }
+
+uint32_t NetworkJitterBufferPlayQueue::getFecRecoveredPackets() { return fec_recovered_packets; }
+
+uint32_t NetworkJitterBufferPlayQueue::getRejectedPackets() { return rejected_packets; }
+
+const RunningStat &NetworkJitterBufferPlayQueue::getRtt() { return rtt; }
+
+const RunningStat &NetworkJitterBufferPlayQueue::getBufferingDelay() { return buffering_delay; }
+
+const RunningStat &NetworkJitterBufferPlayQueue::getLatency() { return latency; }
+
+CpuMeter &NetworkJitterBufferPlayQueue::getEnqueueCpu() { return enqueue_cpu; }
+
+uint32_t NetworkJitterBufferPlayQueue::getJitterPercentile(float p) { return histograms.jitter.getPercentile(p); } // written in loop() only
+
+void NetworkJitterBufferPlayQueue::snapshotHistograms(queue_histograms_t &snapshot) {
+    AudioNoInterrupts(); // update() adds to the histograms
+    snapshot = histograms;
+    AudioInterrupts();
+}
+
+void NetworkJitterBufferPlayQueue::resetHistograms() {
+    AudioNoInterrupts();
+    histograms.jitter.reset();
+    histograms.length.reset();
+    histograms.lateness.reset();
+    histograms.gaps.reset();
+    AudioInterrupts();
+}
+
+void NetworkJitterBufferPlayQueue::printHistograms() {
+    queue_histograms_t h;
+    snapshotHistograms(h);
+    h.jitter.print("Jitter", "us");
+    h.length.print("Queue length at playout", "blocks");
+    h.lateness.print("Lateness of late packets", "us");
+    h.gaps.print("Concealment gaps", "blocks");
 }
 
 void NetworkJitterBufferPlayQueue::printStatistics() {
@@ -86,10 +180,30 @@ void NetworkJitterBufferPlayQueue::printStatistics() {
     Serial.printf("Queue length (subindex): %lu (%lu)\r\n", getQueueLength(),subindex);
     Serial.printf("Early/late packets:      %lu / %lu\r\n", early_packets, late_packets);
     Serial.printf("Recoveries succ/fail:    %lu / %lu\r\n", recoveries_success, recoveries_failed);
+    Serial.printf("Concealed packets:       %lu\r\n", concealed_packets);
+    Serial.printf("FEC recovered packets:   %lu\r\n", fec_recovered_packets);
+    Serial.printf("Rejected packets:        %lu\r\n", rejected_packets);
+    Serial.printf("Jitter (us):             %lu\r\n", getJitter());
+    Serial.printf("Jitter p99/p99.9 (us):   %lu / %lu\r\n", getJitterPercentile(0.99f), getJitterPercentile(0.999f));
+    Serial.printf("RTT (us):                %lu / %lu / %lu (min/avg/max)\r\n", rtt.getMin(), rtt.getAvg(), rtt.getMax());
+    Serial.printf("One-way delay (us):      %lu / %lu / %lu\r\n", rtt.getMin() / 2, rtt.getAvg() / 2, rtt.getMax() / 2);
+    Serial.printf("Buffering delay (us):    %lu / %lu / %lu\r\n", buffering_delay.getMin(), buffering_delay.getAvg(), buffering_delay.getMax());
+    Serial.printf("Total latency (us):      %lu / %lu / %lu\r\n", latency.getMin(), latency.getAvg(), latency.getMax());
+    Serial.printf("Prefill/max (adaptive):  %ld / %ld (%d)\r\n", prefill, max_buffers, adaptive);
+    Serial.printf("Capacity, blocks/packet: %lu, %lu\r\n", getCapacity(), blocks_per_packet);
+    Serial.printf("Drift correction (ppm):  %.1f\r\n", getDriftPpm());
+    Serial.printf("CPU update (%%):          %.2f (peak %.2f)\r\n", processorUsage(), processorUsageMax());
+    Serial.printf("CPU enqueue (%%):         %.2f (peak %.2f, longest %.1f us)\r\n", enqueue_cpu.getUsage(), enqueue_cpu.getUsageMax(), enqueue_cpu.getCallMaxUs());
     Serial.printf("Mem:                     %d\r\n", AudioMemoryUsage());
     Serial.printf("===============================\r\n");
 }
 
+void NetworkJitterBufferPlayQueue::printStatisticsIfDue() {
+    if (!statistics_due) return;
+    statistics_due = false;
+    printStatistics();
+}
+
 void NetworkJitterBufferPlayQueue::resetStatistics() {
     count = 0;
     subindex = 0;
@@ -97,10 +211,29 @@ void NetworkJitterBufferPlayQueue::resetStatistics() {
     early_packets = 0;
     recoveries_success = 0;
     recoveries_failed = 0;
+    concealed_packets = 0;
+    fec_recovered_packets = 0;
+    rejected_packets = 0;
+    rtt.reset();
+    buffering_delay.reset();
+    latency.reset();
+    resetHistograms();
+    enqueue_cpu.reset();
+    processorUsageMaxReset();
+    plc_active = false;
+    jitter = 0;
+    last_arrival_valid = false;
+    depth_margin = 0;
+    window_blocks = 0;
+    window_events = 0;
+    window_min_length = max_buffers;
+    step_delta = 0;
+    drift_integral = 0;
+    settle_packets = 0;
 }
 
 void NetworkJitterBufferPlayQueue::setMaxBuffers(uint8_t val) {
-    if (val <= OPENREMJAM_PLAY_QUEUE_MAX_LENGTH && val >= 2) {
+    if (val <= getCapacity() && val >= 2) {
         setPrefill(val / 2); // adjust prefill as well!
         max_buffers = val;
     } else {
@@ -110,52 +243,184 @@ void NetworkJitterBufferPlayQueue::setMaxBuffers(uint8_t val) {
 
 uint8_t NetworkJitterBufferPlayQueue::getMaxBuffers() { return max_buffers; }
 
+uint32_t NetworkJitterBufferPlayQueue::getCapacity() { return capacity_mask + 1; }
+
+boolean NetworkJitterBufferPlayQueue::setCapacity(uint32_t n) {
+    if (state != State::stopped || !isValidCapacity(n)) return false;
+    capacity_mask = n - 1;
+    free_head = 0; // nothing is queued while stopped
+    used_tail = 0;
+    if (max_buffers > (int32_t)n) setMaxBuffers(n);
+    return true;
+}
+
+uint32_t NetworkJitterBufferPlayQueue::getMaxCapacity() { return max_capacity; }
+
+boolean NetworkJitterBufferPlayQueue::isValidCapacity(uint32_t n) { return n >= 2 && n <= max_capacity && !(n & (n - 1)); }
+
+boolean NetworkJitterBufferPlayQueue::hasSlots() { return spare != nullptr; }
+
+int32_t NetworkJitterBufferPlayQueue::getMaxQueueLength() {
+    // one slot of the ring stays free, otherwise a full queue would look empty
+    return (max_buffers <= (int32_t)capacity_mask) ? max_buffers : capacity_mask;
+}
+
+uint32_t NetworkJitterBufferPlayQueue::getBlocksPerPacket() { return blocks_per_packet; }
+
+uint32_t NetworkJitterBufferPlayQueue::getPacketSize(Codec c) {
+    if (c == Codec::adpcm) return OPENREMJAM_HEADER_SIZE + OPENREMJAM_ADPCM_HEADER_SIZE + samples_per_packet / 2;
+    return OPENREMJAM_HEADER_SIZE + samples_per_packet * sizeof(int16_t);
+}
+
+void NetworkJitterBufferPlayQueue::setSendCodec(Codec c) { send_codec = c; }
+
+Codec NetworkJitterBufferPlayQueue::getSendCodec() { return send_codec; }
+
 void NetworkJitterBufferPlayQueue::setPrefill(uint8_t val) { prefill = val; }
 
 uint8_t NetworkJitterBufferPlayQueue::getPrefill() { return prefill; }
 
+void NetworkJitterBufferPlayQueue::setAdaptive(boolean val) {
+    adaptive = val;
+    depth_margin = 0;
+    quiet_windows = 0;
+    window_blocks = 0;
+    window_events = late_packets + recoveries_success + recoveries_failed;
+    window_min_length = max_buffers;
+}
+
+boolean NetworkJitterBufferPlayQueue::getAdaptive() { return adaptive; }
+
+void NetworkJitterBufferPlayQueue::setAdaptiveMaxEventRate(uint16_t val) { adaptive_max_event_rate = val; }
+
+uint16_t NetworkJitterBufferPlayQueue::getAdaptiveMaxEventRate() { return adaptive_max_event_rate; }
+
+uint32_t NetworkJitterBufferPlayQueue::getJitter() { return jitter >> 4; }
+
+void NetworkJitterBufferPlayQueue::setDriftCompensation(boolean val) {
+    drift_compensation = val;
+    step_delta = 0;
+    drift_integral = 0;
+    settle_packets = 0;
+}
+
+boolean NetworkJitterBufferPlayQueue::getDriftCompensation() { return drift_compensation; }
+
+float NetworkJitterBufferPlayQueue::getDriftPpm() { return step_delta * (1e6f / 4294967296.0f); }
+
+void NetworkJitterBufferPlayQueue::warmStart(uint8_t val, uint32_t jitter_us, float drift_ppm) {
+    if (val >= 1 && val <= max_buffers) setPrefill(val);
+    jitter = jitter_us << 4;
+    if (adaptive) {
+        // the margin adaptDepth() had learned on top of the jitter based depth
+        int32_t jitter_blocks = (3 * jitter_us + packet_duration_us - 1) / packet_duration_us;
+        depth_margin = prefill - 2 - jitter_blocks;
+        if (depth_margin < 0) depth_margin = 0;
+        if (depth_margin > max_buffers) depth_margin = max_buffers;
+    }
+    if (drift_compensation) {
+        // estimateDrift() holds step_delta while it settles, then the integral part goes on from here
+        const float max = OPENREMJAM_DRIFT_MAX_PPM * 1e-6f;
+        float correction = drift_ppm * 1e-6f;
+        if (correction > max) correction = max;
+        if (correction < -max) correction = -max;
+        drift_integral = correction;
+        step_delta = (int32_t)(correction * 4294967296.0f);
+    }
+}
+
+boolean NetworkJitterBufferPlayQueue::isPlaying() { return state == State::playing; }
+
 
 /***** HELPER ****/
 
 uint32_t NetworkJitterBufferPlayQueue::nextIndex(uint32_t index) {
-    return (index + 1) % max_buffers;
+    return (index + 1) & capacity_mask;
 }
 
 uint32_t NetworkJitterBufferPlayQueue::prevIndex(uint32_t index) {
-    return ((index==0) ? (max_buffers - 1) : (index - 1));
+    return (index - 1) & capacity_mask;
 }
 
 uint32_t NetworkJitterBufferPlayQueue::nthIndexAfter(uint32_t index, uint32_t n) {
-    return (index + n) % max_buffers;
+    return (index + n) & capacity_mask;
 }
 
-void NetworkJitterBufferPlayQueue::placePacketIntoIndex(network_block_t * packet, uint32_t index) {
+void NetworkJitterBufferPlayQueue::placePacketIntoIndex(int16_t * packet, uint32_t index) {
+    network_block_info_t *prev = infoAt(prevIndex(index));
+
     if (!packet) {
-        // generate empty packet with consecutive seqno and current timestamp:
-        memset(&queue[index], 0, OPENREMJAM_MONO_PACKET_SIZE-4);
-        queue[index].seqno=queue[prevIndex(index)].seqno + 1;
-        queue[index].timestamp=micros();
-        Serial.printf("Index: %d, Generated seqno: %d, currently playing seqno: %d\r\n", index, queue[index].seqno, queue[used_tail].seqno);
+        // generate concealed packet with consecutive seqno and current timestamp:
+        // continue the preceding audio and fade out over OPENREMJAM_PLC_FADE_BLOCKS consecutive concealed blocks
+        infoAt(index)->concealed = prev->concealed + 1;
+        if (infoAt(index)->concealed > OPENREMJAM_PLC_FADE_BLOCKS) {
+            memset(samplesAt(index), 0, samples_per_packet * sizeof(int16_t));
+            infoAt(index)->plc_lag = prev->plc_lag;
+        } else {
+            // the preceding block has faded already, so fade relative to it
+            int16_t history[OPENREMJAM_PLC_HISTORY];
+            PacketLossConcealer concealer;
+            concealer.begin(history, gatherHistory(index, history),
+                            (OPENREMJAM_PLC_FADE_BLOCKS - infoAt(index)->concealed + 1) * samples_per_packet);
+            concealer.synthesize(samplesAt(index), samples_per_packet);
+            infoAt(index)->plc_lag = concealer.getLag(); // the concealed audio repeats this period
+        }
+        infoAt(index)->seqno=prev->seqno + 1;
+        infoAt(index)->timestamp=micros();
+        concealed_packets++;
+        OPENREMJAM_LOG_DEBUG("Index: %d, Generated seqno: %d, currently playing seqno: %d", index, infoAt(index)->seqno, infoAt(used_tail)->seqno);
     } else {
-        memcpy(&queue[index], packet, OPENREMJAM_MONO_PACKET_SIZE + 4); // +4 because of timestamp!
+        // packet is the receive buffer: swap it into the slot, the slot's old storage becomes the next receive buffer.
+        // A received packet also replaces a concealed one that has not been played yet.
+        spare = queue[index];
+        queue[index] = packet;
+        infoAt(index)->concealed = 0;
+        if (index == free_head) {
+            // the newest block: if the queue runs dry after it, update() conceals with this pitch period (the search
+            // is too expensive for the audio interrupt). Blocks filled in behind it are never the last one played
+            int16_t history[OPENREMJAM_PLC_HISTORY];
+            infoAt(index)->plc_lag = PacketLossConcealer::estimateLag(history, gatherHistory(nextIndex(index), history));
+        }
+    }
+}
+
+uint32_t NetworkJitterBufferPlayQueue::gatherHistory(uint32_t index, int16_t * history) {
+    // walk back from the block preceding index, filling history from its end
+    uint32_t len = 0;
+    uint32_t i = index;
+    for (int32_t blocks = 0; blocks < max_buffers - 1 && len < OPENREMJAM_PLC_HISTORY; ++blocks) {
+        i = prevIndex(i);
+        uint32_t n = samples_per_packet;
+        if (n > OPENREMJAM_PLC_HISTORY - len) n = OPENREMJAM_PLC_HISTORY - len;
+        len += n;
+        memcpy(&history[OPENREMJAM_PLC_HISTORY - len], &samplesAt(i)[samples_per_packet - n], n * sizeof(int16_t));
     }
+    if (len < OPENREMJAM_PLC_HISTORY) memmove(history, &history[OPENREMJAM_PLC_HISTORY - len], len * sizeof(int16_t));
+    return len;
+}
+
+int32_t NetworkJitterBufferPlayQueue::findReceived(uint32_t seqno) {
+    // slots keep their packet until it is overwritten, also after it has been played
+    uint32_t index = nthIndexAfter(used_tail, seqno - infoAt(used_tail)->seqno);
+    if (infoAt(index)->seqno != seqno || infoAt(index)->concealed) return -1;
+    return index;
 }
 
 bool NetworkJitterBufferPlayQueue::checkPacketContinuityWithPrevious(uint32_t index) {
-    if (queue[prevIndex(index)].seqno + 1 != queue[index].seqno) {
-        Serial.printf("prev seqno: %d, my seqno: %d\r\n", queue[prevIndex(index)].seqno, queue[index].seqno);
+    if (infoAt(prevIndex(index))->seqno + 1 != infoAt(index)->seqno) {
+        OPENREMJAM_LOG_DEBUG("prev seqno: %d, my seqno: %d", infoAt(prevIndex(index))->seqno, infoAt(index)->seqno);
         return false;
     }
     
     // previous timestamp should be at least ~1 ms smaller than current (@128 samples per packet)
-    if (queue[prevIndex(index)].timestamp + OPENREMJAM_MONO_PACKET_DURATION_US/3 > queue[index].timestamp) {
-        Serial.printf("prev timestamp: %d, my timestamp: %d\r\n", queue[prevIndex(index)].timestamp, queue[index].timestamp);
+    if (infoAt(prevIndex(index))->timestamp + packet_duration_us/3 > infoAt(index)->timestamp) {
+        OPENREMJAM_LOG_DEBUG("prev timestamp: %d, my timestamp: %d", infoAt(prevIndex(index))->timestamp, infoAt(index)->timestamp);
         return false;
     }
     
     // previous timestamp should be no more ~4 ms smaller than current (@128 samples per packet)
-    if (queue[prevIndex(index)].timestamp + OPENREMJAM_MONO_PACKET_DURATION_US*4/3 < queue[index].timestamp) {
-        Serial.printf("prev timestamp: %d, my timestamp: %d\r\n", queue[prevIndex(index)].timestamp, queue[index].timestamp);
+    if (infoAt(prevIndex(index))->timestamp + packet_duration_us*4/3 < infoAt(index)->timestamp) {
+        OPENREMJAM_LOG_DEBUG("prev timestamp: %d, my timestamp: %d", infoAt(prevIndex(index))->timestamp, infoAt(index)->timestamp);
         return false;
     }
     return true;
@@ -165,58 +430,70 @@ void NetworkJitterBufferPlayQueue::switchState(State s) {
     switch(state) {
         case (State::stopped):
             if (s==State::syncing) {
+                if (!hasSlots() && !acquireSlots()) {
+                    OPENREMJAM_LOG_WARNING("WARNING: switchState() -- %d slots needed, block pool has %d free!", capacity_mask + 2, NetworkBlockPool::getFree());
+                    break;
+                }
                 state=s;
-                Serial.println("switchState() -- new state: syncing");
+                OPENREMJAM_LOG_INFO("switchState() -- new state: syncing");
             } else {
-                Serial.println("WARNING: switchState() -- invalid transition from state stopped!");
+                OPENREMJAM_LOG_WARNING("WARNING: switchState() -- invalid transition from state stopped!");
             }
             break;
         case (State::syncing):
             if (s==State::stopped) {
                 state=s;
                 resetStatistics();
-                Serial.println("switchState() -- new state: stopped");
+                OPENREMJAM_LOG_INFO("switchState() -- new state: stopped");
             } else if (s==State::playing) {
                 state=s;
-                Serial.println("switchState() -- new state: playing");
+                read_index = subindex * AUDIO_BLOCK_SAMPLES;
+                read_frac = 0;
+                settle_packets = 0;
+                OPENREMJAM_LOG_INFO("switchState() -- new state: playing");
             } else {
-                Serial.println("WARNING: switchState() -- invalid transition from state syncing!");
+                OPENREMJAM_LOG_WARNING("WARNING: switchState() -- invalid transition from state syncing!");
             }
             break;
         case (State::playing):
             if (s==State::stopped) {
                 state=s;
                 resetStatistics();
-                Serial.println("switchState() -- new state: stopped");
+                OPENREMJAM_LOG_INFO("switchState() -- new state: stopped");
             } else if (s==State::recovering) {
                 state=s;
                 recoveryStart = millis();
-                Serial.println("switchState() -- new state: recovering");
+                OPENREMJAM_LOG_INFO("switchState() -- new state: recovering");
             } else {
-                Serial.println("WARNING: switchState() -- invalid transition from state playing!");
+                OPENREMJAM_LOG_WARNING("WARNING: switchState() -- invalid transition from state playing!");
             }
             break;
         case (State::recovering):
             if (s==State::stopped) {
                 state=s;
                 resetStatistics();
-                Serial.println("switchState() -- new state: stopped");
+                OPENREMJAM_LOG_INFO("switchState() -- new state: stopped");
             } else if (s==State::syncing) {
                 state=s;
                 recoveries_failed++;
-                Serial.println("switchState() -- new state: syncing");
+                OPENREMJAM_LOG_INFO("switchState() -- new state: syncing");
             } else if (s==State::playing) {
                 state=s;
                 recoveries_success++;
-                Serial.println("switchState() -- new state: playing");
+                settle_packets = 0;
+                OPENREMJAM_LOG_INFO("switchState() -- new state: playing");
             } else {
-                Serial.println("WARNING: switchState() -- invalid transition from state playing!");
+                OPENREMJAM_LOG_WARNING("WARNING: switchState() -- invalid transition from state playing!");
             }
             break;
         default:
-            Serial.println("WARNING: switchState() -- invalid state!");
+            OPENREMJAM_LOG_WARNING("WARNING: switchState() -- invalid state!");
             break;
     }
+    // only a playing (or recovering) queue produces audio: take the others out of the audio update cycle
+    active = (state == State::playing || state == State::recovering);
+    // update() does not touch the slots of a stopped queue: a pooled queue returns them
+    if (state == State::stopped && hasSlots()) releaseSlots();
 }
 
 bool NetworkJitterBufferPlayQueue::recoveryTimeout() {
@@ -224,13 +501,274 @@ bool NetworkJitterBufferPlayQueue::recoveryTimeout() {
     return false;
 }
 
+void NetworkJitterBufferPlayQueue::estimateJitter(network_block_info_t * packet) {
+    // RFC 3550: J += (|D| - J) / 16, D = difference of arrival spacing and sending spacing
+    int32_t seqno_delta = packet->seqno - last_arrival_seqno;
+    if (last_arrival_valid && seqno_delta < 1) return; // reordered packet, keep the reference
+    if (last_arrival_valid && seqno_delta <= max_buffers) {
+        int32_t d = (int32_t)(packet->timestamp - last_arrival) - seqno_delta * packet_duration_us;
+        if (d < 0) d = -d;
+        jitter += d - (jitter >> 4);
+        histograms.jitter.add(d);
+    }
+    last_arrival = packet->timestamp;
+    last_arrival_seqno = packet->seqno;
+    last_arrival_valid = true;
+}
+
+void NetworkJitterBufferPlayQueue::measureRtt(const openremjam_header_t &h) {
+    uint32_t now = micros();
+    if (h.echo_timestamp) {
+        // our timestamp came back: round trip = elapsed time minus the time it was held by the remote host
+        int32_t d = (int32_t)(now - h.echo_timestamp - h.echo_delay);
+        if (d >= 0) {
+            rtt.add(d);
+            one_way_delay = d / 2; // clocks are not synchronized: assume a symmetric path
+        }
+    }
+    echo_timestamp = h.timestamp;
+    echo_received = now;
+}
+
+void NetworkJitterBufferPlayQueue::measureLatency(int32_t seqno_delta) {
+    // the block starts playing after the preceding ones, minus the part of the current block played already
+    const uint32_t block_us = AUDIO_BLOCK_SAMPLES * 1000000 / 44100;
+    uint32_t buffering = (seqno_delta * blocks_per_packet - subindex) * block_us;
+    buffering_delay.add(buffering);
+    if (one_way_delay) latency.add(packet_duration_us + one_way_delay + buffering + block_us);
+}
+
+void NetworkJitterBufferPlayQueue::adaptDepth() {
+    // called at each network block boundary while playing
+    int32_t length = getQueueLength();
+    if (length < window_min_length) window_min_length = length;
+    if (++window_blocks < OPENREMJAM_ADAPTIVE_WINDOW) return;
+
+    uint32_t events = late_packets + recoveries_success + recoveries_failed;
+    uint32_t window_event_count = events - window_events;
+    if (window_event_count * 10000 > (uint32_t)adaptive_max_event_rate * window_blocks) {
+        // too many late packets or recoveries: add headroom
+        if (depth_margin < max_buffers) depth_margin++;
+        quiet_windows = 0;
+    } else if (!window_event_count) {
+        // shrink slowly, after several clean windows
+        if (++quiet_windows >= OPENREMJAM_ADAPTIVE_QUIET_WINDOWS) {
+            if (depth_margin > 0) depth_margin--;
+            quiet_windows = 0;
+        }
+    } else {
+        quiet_windows = 0;
+    }
+
+    // cover ~3 times the mean jitter, plus the learned margin
+    int32_t jitter_blocks = (3 * getJitter() + packet_duration_us - 1) / packet_duration_us;
+    int32_t target = 2 + jitter_blocks + depth_margin;
+    if (target > max_buffers - 1) target = max_buffers - 1;
+    if (target < 2) target = 2;
+    prefill = target;
+
+    // the queue has been deeper than the target during the whole window: drop one block to reduce latency
+    if (window_min_length > prefill && length >= 2) {
+        dequeue();
+        settle_packets = 0; // the buffer level changed on purpose: take a new setpoint
+    }
+
+    window_blocks = 0;
+    window_events = events;
+    window_min_length = max_buffers;
+}
+
+void NetworkJitterBufferPlayQueue::estimateDrift() {
+    // buffered samples ahead of the read position, right after a packet has been enqueued
+    float level = getQueueLength() * samples_per_packet - (int32_t)read_index;
+
+    if (settle_packets < OPENREMJAM_DRIFT_SETTLE_PACKETS) {
+        // (re)start: average the level that syncing or recovery left us with and hold it from then on
+        level_avg = settle_packets ? level_avg + (level - level_avg) / (settle_packets + 1) : level;
+        if (++settle_packets == OPENREMJAM_DRIFT_SETTLE_PACKETS) level_setpoint = level_avg;
+        return;
+    }
+    level_avg += (level - level_avg) * (1.0f / 64);
+
+    // PI controller: the integral part converges to the clock ratio (sender / receiver) - 1
+    const float kp = 5e-6f;
+    const float ki = 1e-9f;
+    float error = level_avg - level_setpoint;
+    drift_integral += error * ki;
+    const float max = OPENREMJAM_DRIFT_MAX_PPM * 1e-6f;
+    if (drift_integral > max) drift_integral = max;
+    if (drift_integral < -max) drift_integral = -max;
+    float correction = drift_integral + error * kp;
+    if (correction > max) correction = max;
+    if (correction < -max) correction = -max;
+    step_delta = (int32_t)(correction * 4294967296.0f); // single word: update() reads it atomically
+}
+
+bool NetworkJitterBufferPlayQueue::advanceNetworkBlock() {
+    if (getQueueLength() > 1) {
+        dequeue();
+        if (infoAt(used_tail)->concealed == 0 && infoAt(prevIndex(used_tail))->concealed) {
+            // end of a concealed gap: crossfade into the received audio to avoid a click.
+            // Done at playout, a reordered packet may still replace the concealed block before.
+            histograms.gaps.add(infoAt(prevIndex(used_tail))->concealed);
+            int16_t history[OPENREMJAM_PLC_HISTORY];
+            plc.begin(history, gatherHistory(used_tail, history), infoAt(prevIndex(used_tail))->plc_lag,
+                      OPENREMJAM_PLC_FADE_BLOCKS * samples_per_packet);
+            plc.crossfadeInto(samplesAt(used_tail), OPENREMJAM_PLC_CROSSFADE);
+        }
+        if (adaptive) adaptDepth();
+        return true;
+    }
+    // underrun: step into the empty slot of the next network block and conceal it until packets arrive again
+    if (used_tail != free_head) dequeue();
+    network_block_info_t *prev = infoAt(prevIndex(used_tail));
+    infoAt(used_tail)->seqno = prev->seqno + 1;
+    infoAt(used_tail)->concealed = prev->concealed + 1;
+    infoAt(used_tail)->plc_lag = prev->plc_lag;
+    int16_t history[OPENREMJAM_PLC_HISTORY];
+    int32_t fade_blocks = OPENREMJAM_PLC_FADE_BLOCKS - prev->concealed;
+    plc.begin(history, gatherHistory(used_tail, history), prev->plc_lag, fade_blocks > 0 ? fade_blocks * samples_per_packet : 1);
+    plc_active = true;
+    concealed_packets++;
+    switchState(State::recovering);
+    return false;
+}
+
+void NetworkJitterBufferPlayQueue::playResampled(int16_t * out) {
+    const uint32_t n = samples_per_packet;
+    const int64_t step = (1LL << 32) + step_delta;
+    uint64_t pos = ((uint64_t)read_index << 32) | read_frac;
+
+    if (!step_delta && !read_frac && read_index + AUDIO_BLOCK_SAMPLES <= n) {
+        // nominal rate, sample aligned: plain copy
+        memcpy(out, &samplesAt(used_tail)[read_index], AUDIO_BLOCK_SAMPLES*sizeof(int16_t));
+        pos += (uint64_t)AUDIO_BLOCK_SAMPLES << 32;
+        if ((pos >> 32) >= n) {
+            pos -= (uint64_t)n << 32;
+            if (!advanceNetworkBlock()) pos = 0;
+        }
+    } else {
+        // linear interpolation; the last sample of a network block interpolates towards the next one
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; ++i) {
+            uint32_t idx = pos >> 32;
+            int32_t s0 = samplesAt(used_tail)[idx];
+            int32_t s1;
+            if (idx + 1 < n) s1 = samplesAt(used_tail)[idx + 1];
+            else if (getQueueLength() > 1) s1 = samplesAt(nextIndex(used_tail))[0];
+            else s1 = s0;
+            int32_t frac = (uint32_t)pos >> 17; // 15 bits, so the product fits into 32 bits
+            out[i] = s0 + (((s1 - s0) * frac) >> 15);
+            pos += step;
+            if ((pos >> 32) >= n) {
+                pos -= (uint64_t)n << 32;
+                if (!advanceNetworkBlock()) {
+                    plc.synthesize(&out[i + 1], AUDIO_BLOCK_SAMPLES - i - 1);
+                    pos = 0;
+                    break;
+                }
+            }
+        }
+    }
+    read_index = pos >> 32;
+    read_frac = (uint32_t)pos;
+    subindex = read_index / AUDIO_BLOCK_SAMPLES;
+}
+
 /**** HELPER END ***/
 
-void NetworkJitterBufferPlayQueue::enqueue(uint8_t * buffer) {
-    network_block_t* packet = (network_block_t*) buffer; // IMPORTANT: buffer must be large enough to add timestamp!
+void NetworkJitterBufferPlayQueue::enqueue(const uint8_t * packet, uint32_t size) {
+    if (size < OPENREMJAM_HEADER_SIZE) {
+        rejected_packets++;
+        return;
+    }
+    openremjam_header_t h;
+    memcpy(&h, packet, OPENREMJAM_HEADER_SIZE);
+    uint8_t *payload = getPayloadBuffer(h, size);
+    if (!payload) return;
+    memcpy(payload, &packet[OPENREMJAM_HEADER_SIZE], size - OPENREMJAM_HEADER_SIZE);
+    commitPayload(h);
+}
+
+boolean NetworkJitterBufferPlayQueue::isCompatible(const openremjam_header_t &h, uint32_t size) {
+    if (h.magic != OPENREMJAM_MAGIC || h.version != OPENREMJAM_PROTOCOL_VERSION || h.channels != 1 ||
+        h.sample_rate != OPENREMJAM_SAMPLE_RATE || h.blocks != blocks_per_packet) return false;
+    switch (h.type) {
+        case PacketType::audio:
+            return (h.codec == Codec::pcm || h.codec == Codec::adpcm) && size == getPacketSize(h.codec);
+        case PacketType::parity:
+            return h.codec == Codec::pcm && size == getPacketSize(Codec::pcm) && h.fec_group >= 2 && h.fec_group <= OPENREMJAM_FEC_MAX_GROUP;
+        default:
+            return false;
+    }
+}
+
+uint8_t *NetworkJitterBufferPlayQueue::getPayloadBuffer(const openremjam_header_t &h, uint32_t size) {
+    if (!hasSlots()) return nullptr; // pooled queue without slots (stopped, or the pool was exhausted)
+    if (!isCompatible(h, size)) {
+        rejected_packets++;
+        return nullptr;
+    }
+    return (h.codec == Codec::adpcm) ? getCompressedPayloadBuffer() : (uint8_t *)spare;
+}
+
+void NetworkJitterBufferPlayQueue::commitPayload(const openremjam_header_t &h) {
+    measureRtt(h);
+    if (h.type == PacketType::parity) {
+        commitParity(h.seqno, h.fec_group);
+        return;
+    }
+    if (h.codec == Codec::adpcm) ImaAdpcm::decode(getCompressedPayloadBuffer(), samples_per_packet, spare);
+    commitReceived(h.seqno);
+}
+
+void NetworkJitterBufferPlayQueue::fillEcho(openremjam_header_t &h) {
+    h.echo_timestamp = echo_timestamp;
+    h.echo_delay = echo_timestamp ? micros() - echo_received : 0;
+}
+
+uint8_t *NetworkJitterBufferPlayQueue::getCompressedPayloadBuffer() {
+    // the end of the receive buffer: decoding in place writes the samples behind the codes it has read
+    return (uint8_t *)&spare[samples_per_packet] + sizeof(network_block_info_t) - (getPacketSize(Codec::adpcm) - OPENREMJAM_HEADER_SIZE);
+}
+
+void NetworkJitterBufferPlayQueue::commitReceived(uint32_t seqno) {
+    network_block_info_t* packet = (network_block_info_t *)&spare[samples_per_packet]; // behind the samples
+    packet->seqno = seqno;
     packet->timestamp = micros();
     //Serial.printf("enqued - seqno: %d\r\n",packet->seqno);
+    if (state != State::stopped) estimateJitter(packet);
+    placeReceiveBuffer();
+}
+
+void NetworkJitterBufferPlayQueue::commitParity(uint32_t first, uint32_t group) {
+    if (state != State::playing && state != State::recovering) return; // a lost packet during syncing just restarts syncing
+
+    // the parity rebuilds exactly one missing block
+    uint32_t missing = 0;
+    uint32_t missing_cnt = 0;
+    for (uint32_t seqno = first; seqno != first + group; ++seqno) {
+        if (findReceived(seqno) < 0) {
+            missing = seqno;
+            if (++missing_cnt > 1) return;
+        }
+    }
+    if (!missing_cnt) return;
+    int32_t seqno_delta = missing - infoAt(used_tail)->seqno;
+    if (seqno_delta < 1 || seqno_delta >= getMaxQueueLength()) return; // played (concealed) already, or beyond the queue
+
+    // parity XOR the other blocks = missing block. Rebuild it in the receive buffer and enqueue it like a received one
+    for (uint32_t seqno = first; seqno != first + group; ++seqno) {
+        if (seqno != missing) FecEncoder::xorInto(spare, samplesAt(findReceived(seqno)), samples_per_packet * sizeof(int16_t));
+    }
+    network_block_info_t* packet = (network_block_info_t *)&spare[samples_per_packet];
+    packet->seqno = missing;
+    packet->timestamp = micros(); // not an arrival, so the jitter estimate is left alone
+    fec_recovered_packets++;
+    placeReceiveBuffer();
+}
 
+void NetworkJitterBufferPlayQueue::placeReceiveBuffer() {
+    network_block_info_t* packet = (network_block_info_t *)&spare[samples_per_packet];
     int32_t seqno_delta = 0;
 
     switch (state) {
@@ -242,7 +780,7 @@ void NetworkJitterBufferPlayQueue::enqueue(uint8_t * buffer) {
             //Queue must be filled with exactly n==prefill packets.
             //They must have consecutive sequence numbers and sound time stamps (no burst arrival, no reordering)
             
-            placePacketIntoIndex(packet, free_head);
+            placePacketIntoIndex(spare, free_head);
 
             if (free_head != used_tail) { // do we have other packets already?
                 // check if this packets has consecutive seqnos and sound timestaps with respect to the previous
@@ -261,14 +799,19 @@ void NetworkJitterBufferPlayQueue::enqueue(uint8_t * buffer) {
             //Serial.println("Recovering");
         case State::playing:
             //Serial.println("Playing");
-            //Serial.printf("used_tail has seqno: %d (%d)\r\n", queue[used_tail].seqno, queue[used_tail].timestamp);
+            //Serial.printf("used_tail has seqno: %d (%d)\r\n", infoAt(used_tail)->seqno, infoAt(used_tail)->timestamp);
             //Serial.printf("new packet has seqno: %d (%d)\r\n",packet->seqno, packet->timestamp);
-            seqno_delta = packet->seqno - queue[used_tail].seqno;
+            seqno_delta = packet->seqno - infoAt(used_tail)->seqno;
             if (seqno_delta < 1) {
-                //Serial.printf("Late packet -- max_buffers: %d, used_tail has index: %d (seqno: %d), free_head has index: %d, queue length: %d, seqno: %d, seqno_delta: %d\r\n", max_buffers, used_tail, queue[used_tail].seqno, free_head, getQueueLength(), packet->seqno, seqno_delta);
+                //Serial.printf("Late packet -- max_buffers: %d, used_tail has index: %d (seqno: %d), free_head has index: %d, queue length: %d, seqno: %d, seqno_delta: %d\r\n", max_buffers, used_tail, infoAt(used_tail)->seqno, free_head, getQueueLength(), packet->seqno, seqno_delta);
                 late_packets++;
-            } else if (seqno_delta > max_buffers - 1) {
-                //Serial.printf("Early packet -- max_buffers: %d, used_tail has index: %d (seqno: %d), free_head has index: %d, queue length: %d, seqno: %d, seqno_delta: %d\r\n", max_buffers, used_tail, queue[used_tail].seqno, free_head, getQueueLength(), packet->seqno, seqno_delta);
+                // samples played since the first sample of the packet was due: the network blocks before the current
+                // one plus the playout position in it (resampling moves read_index, not in steps of audio blocks)
+                uint32_t played = drift_compensation ? read_index : subindex * AUDIO_BLOCK_SAMPLES;
+                uint32_t late_samples = -seqno_delta * samples_per_packet + played;
+                histograms.lateness.add((uint32_t)(late_samples * 1000000.0f / AUDIO_SAMPLE_RATE_EXACT));
+            } else if (seqno_delta >= getMaxQueueLength()) {
+                //Serial.printf("Early packet -- max_buffers: %d, used_tail has index: %d (seqno: %d), free_head has index: %d, queue length: %d, seqno: %d, seqno_delta: %d\r\n", max_buffers, used_tail, infoAt(used_tail)->seqno, free_head, getQueueLength(), packet->seqno, seqno_delta);
                 early_packets++;
             } else {
                 // create zero-padded packets if neccessary
@@ -281,27 +824,29 @@ void NetworkJitterBufferPlayQueue::enqueue(uint8_t * buffer) {
                         free_head = nextIndex(free_head);
                     }
                     // place the packet:
-                    placePacketIntoIndex(packet, free_head);
+                    placePacketIntoIndex(spare, free_head);
                     free_head = nextIndex(free_head);
                 } else if (seqno_delta == getQueueLength()) {
-                    placePacketIntoIndex(packet, free_head);
+                    placePacketIntoIndex(spare, free_head);
                     free_head = nextIndex(free_head);
                 } else {
                     // late arriving packet, free head has been advanced already
-                    placePacketIntoIndex(packet, nthIndexAfter(used_tail, seqno_delta));
+                    placePacketIntoIndex(spare, nthIndexAfter(used_tail, seqno_delta));
                 }
                 
-                if (state==State::recovering && getQueueLength() == prefill) switchState(State::playing);
+                if (state==State::playing) measureLatency(seqno_delta);
+                if (state==State::recovering && getQueueLength() >= prefill) switchState(State::playing); // >=: a burst may overshoot prefill
+                if (state==State::playing && drift_compensation) estimateDrift();
             }
             break;
         default:
-            Serial.println("WARNING: enqueue() -- invalid state!");
+            OPENREMJAM_LOG_WARNING("WARNING: enqueue() -- invalid state!");
             break;
     }
 }
 
 void NetworkJitterBufferPlayQueue::dequeue() {
-    used_tail = (used_tail + 1) % max_buffers;
+    used_tail = (used_tail + 1) & capacity_mask;
     //Serial.printf("used_tail: %i\r\n", used_tail);
 }
 
@@ -311,22 +856,26 @@ void NetworkJitterBufferPlayQueue::update(void) {
     switch (state) {
         case State::stopped:
         case State::syncing:
-            return; // no audio playback!
-            break;
+            active = false; // no audio playback! Not called again until switchState() starts playing (AudioConnection sets active)
+            return;
         case State::playing:
             block = allocate();
             if (!block) {
-                Serial.println("Error: update() -- could not allocate audio block!");
+                OPENREMJAM_LOG_ERROR("Error: update() -- could not allocate audio block!");
                 return;
             }
-            memcpy(block->data,&queue[used_tail].samples[subindex*AUDIO_BLOCK_SAMPLES], AUDIO_BLOCK_SAMPLES*sizeof(int16_t));
-            subindex = (subindex + 1) % OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK;
-            if (!subindex) {
-                if (used_tail!=free_head) {
-                    dequeue();
-                } else {
-                    switchState(State::recovering);
-                }
+            histograms.length.add(getQueueLength());
+            if (drift_compensation) {
+                playResampled(block->data);
+            } else {
+                memcpy(block->data,&samplesAt(used_tail)[subindex*AUDIO_BLOCK_SAMPLES], AUDIO_BLOCK_SAMPLES*sizeof(int16_t));
+                subindex = (subindex + 1) % blocks_per_packet;
+                if (!subindex) advanceNetworkBlock();
+            }
+            if (plc_active && state == State::playing) {
+                // first block after an underrun: fade from the concealment into the received audio
+                plc.crossfadeInto(block->data, AUDIO_BLOCK_SAMPLES < OPENREMJAM_PLC_CROSSFADE ? AUDIO_BLOCK_SAMPLES : OPENREMJAM_PLC_CROSSFADE);
+                plc_active = false;
             }
             transmit(block);
             release(block);
@@ -334,27 +883,30 @@ void NetworkJitterBufferPlayQueue::update(void) {
         case State::recovering:
             block = allocate();
             if (!block) {
-                Serial.println("Error: update() -- could not allocate audio block!");
+                OPENREMJAM_LOG_ERROR("Error: update() -- could not allocate audio block!");
                 return;
             }
-            memset(block->data, 0, AUDIO_BLOCK_SAMPLES*sizeof(int16_t));
-            subindex = (subindex + 1) % OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK;
+            plc.synthesize(block->data, AUDIO_BLOCK_SAMPLES);
+            subindex = (subindex + 1) % blocks_per_packet;
+            read_index = subindex * AUDIO_BLOCK_SAMPLES; // resume resampling block aligned
+            read_frac = 0;
             if (!subindex) {
                 if (recoveryTimeout()) {
                     switchState(State::syncing);
-                } else {
-                    queue[used_tail].seqno++; // just increment seqno for recovery
+                } else if (!getQueueLength()) {
+                    infoAt(used_tail)->seqno++; // nothing received yet: the concealed block has been played
                 }
+                // otherwise hold: packets are queued behind used_tail and playback resumes from there
             }
             transmit(block);
             release(block);
             break;
         default:
-            Serial.println("WARNING: update() -- invalid state!");
+            OPENREMJAM_LOG_WARNING("WARNING: update() -- invalid state!");
             break;
     }
     
     if (++count % 10000 == 0) {
-        printStatistics();
+        statistics_due = true; // printed by loop(), see printStatisticsIfDue()
     }
 }
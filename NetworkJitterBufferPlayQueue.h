@@ -1,42 +1,69 @@
 #pragma once
 
 #define OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK (8)     // default: 8 (good choice if AUDIO_BLOCK_SAMPLES has value 16)
-#define OPENREMJAM_PLAY_QUEUE_SIZE (10)                   // default: 10
+#define OPENREMJAM_PLAY_QUEUE_SIZE (8)                    // default: 8 (slots of the default queue, power of two)
+#define OPENREMJAM_PLAY_QUEUE_MAX_SIZE (32)               // default: 32 (largest capacity the default queue can be given at runtime, see setCapacity())
 #define OPENREMJAM_DEFAULT_UDP_PORT (9000)                // default: 9000
+#define OPENREMJAM_ADAPTIVE_WINDOW (1024)                 // default: 1024 (network blocks per adaptation step, ~3 s)
+#define OPENREMJAM_ADAPTIVE_MAX_EVENT_RATE (10)           // default: 10 (tolerated late packets + recoveries per 10000 network blocks)
+#define OPENREMJAM_ADAPTIVE_QUIET_WINDOWS (4)             // default: 4 (windows without events before the depth is reduced)
+#define OPENREMJAM_DRIFT_MAX_PPM (1000)                   // default: 1000 (maximum sample rate correction of the resampler)
+#define OPENREMJAM_DRIFT_SETTLE_PACKETS (256)             // default: 256 (packets to average before the buffer level setpoint is taken)
+#define OPENREMJAM_HISTOGRAM_US_PER_BUCKET (250)          // default: 250 (bucket width of the jitter and lateness histograms)
 
 // DO NOT CHANGE THESE:
-#define OPENREMJAM_PLAY_QUEUE_MAX_LENGTH (OPENREMJAM_PLAY_QUEUE_SIZE - 1)
-#define OPENREMJAM_MONO_PACKET_SIZE (AUDIO_BLOCK_SAMPLES * OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK * 2 + 4)
+#define OPENREMJAM_MONO_PACKET_SIZE (OPENREMJAM_HEADER_SIZE + AUDIO_BLOCK_SAMPLES * OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK * 2)
+#define OPENREMJAM_MONO_ADPCM_PACKET_SIZE (OPENREMJAM_HEADER_SIZE + OPENREMJAM_ADPCM_HEADER_SIZE + AUDIO_BLOCK_SAMPLES * OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK / 2)
 #define OPENREMJAM_MONO_PACKET_DURATION_US (AUDIO_BLOCK_SAMPLES * OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK * 1000000 / 44100)
+#define OPENREMJAM_SAMPLES_PER_NETWORK_BLOCK (AUDIO_BLOCK_SAMPLES * OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK)
 
 #include "NativeEthernet.h"
 #include "Audio.h"
 #include "fnet.h"
+#include "PacketLossConcealer.h"
+#include "ImaAdpcm.h"
+#include "PacketHeader.h"
+#include "RunningStat.h"
+#include "Histogram.h"
+#include "EventLog.h"
+#include "CpuMeter.h"
+#include "NetworkBlockPool.h"
 
 
 /**
- * @brief Packet on the network. Consists of samples of one or more audio blocks
+ * @brief A queue slot stores the samples of a network block, followed by this struct (seqno is taken from the
+ *        packet header, the other fields are local)
  *
  */
-typedef struct network_block_struct {
-  int16_t samples[AUDIO_BLOCK_SAMPLES * OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK];
+typedef struct network_block_info_struct {
   uint32_t seqno;
   uint32_t timestamp;
-} network_block_t;
+  uint32_t concealed;   // 0: received audio, n > 0: n-th consecutive block synthesized by packet loss concealment
+  uint32_t plc_lag;     // pitch period of the audio up to the end of this block, estimated in loop() for update()
+} network_block_info_t;
+
+
+/**
+ * @brief Distributions measured by a queue, see NetworkJitterBufferPlayQueue::snapshotHistograms()
+ *
+ */
+typedef struct queue_histograms_struct {
+  Histogram jitter{OPENREMJAM_HISTOGRAM_US_PER_BUCKET};   // deviation of each packet's arrival from its expected arrival, us
+  Histogram length{1};                                    // queue length (network blocks) when an audio block is played
+  Histogram lateness{OPENREMJAM_HISTOGRAM_US_PER_BUCKET}; // how long ago the first sample of a late packet was due, us
+  Histogram gaps{1};                                      // consecutive concealed network blocks per concealment gap
+} queue_histograms_t;
 
 
 /**
  * @brief Jitter buffer queue. Receives audio samples from the network and plays them out continuously, mitigating network jitter.
+ *        The slots are provided by NetworkJitterBufferRing (part of the queue) or NetworkJitterBufferPooledRing
+ *        (borrowed from NetworkBlockPool while connected), which fix the largest capacity and the packetization at
+ *        compile time.
  * 
  */
 class NetworkJitterBufferPlayQueue : public AudioStream {
   public:
-
-    /**
-     * @brief Construct a new NetworkJitterBufferPlayQueue object
-     * 
-     */
-    NetworkJitterBufferPlayQueue(void);
     
     /**
      * @brief Set the remote IPv4 address
@@ -67,11 +94,12 @@ class NetworkJitterBufferPlayQueue : public AudioStream {
     IPAddress getIP();
 
     /**
-     * @brief Set the remote sockaddr of this queue
+     * @brief Set the remote sockaddr of this queue, see setPort()
      * 
      * @param val sockaddr
+     * @return boolean false if a queue that is connected this way gets no slots (the port is cleared again)
      */
-    void setSockaddr(struct fnet_sockaddr &val);
+    boolean setSockaddr(struct fnet_sockaddr &val);
 
 
     /**
@@ -103,11 +131,21 @@ class NetworkJitterBufferPlayQueue : public AudioStream {
     boolean hasIP6();
 
     /**
-     * @brief Set the remote port number. A non-zero value sets this queue active.
+     * @brief Is the remote host this device itself (127.x.x.x)?
+     * 
+     * @return boolean 
+     */
+    boolean isLoopback();
+
+    /**
+     * @brief Set the remote port number. A non-zero value sets this queue active: it leaves state stopped and gets its
+     *        slots (see acquireSlots()). Use QueueController::connect(), which also updates the lookup of incoming
+     *        packets.
      * 
      * @param port port number
+     * @return boolean false if the queue gets no slots: the port is cleared again, the queue stays stopped
      */
-    void setPort(uint16_t port);
+    boolean setPort(uint16_t port);
 
     /**
      * @brief Get the remote port number of this queue. A non-zero value indicates that this queue is active.
@@ -117,11 +155,48 @@ class NetworkJitterBufferPlayQueue : public AudioStream {
     uint16_t getPort();
 
     /**
-     * @brief Enqueue one new network packet into this queue
+     * @brief Enqueue one new network packet into this queue (copies the packet, see getPayloadBuffer() for zero-copy receive)
+     * 
+     * @param packet header and payload
+     * @param size size in bytes
+     */
+    void enqueue(const uint8_t *packet, uint32_t size);
+
+    /**
+     * @brief Does a packet match the stream this queue plays (magic, version, format, packetization, codec, size)?
+     * 
+     * @param h packet header
+     * @param size packet size in bytes, including the header
+     * @return boolean 
+     */
+    boolean isCompatible(const openremjam_header_t &h, uint32_t size);
+
+    /**
+     * @brief Get the buffer the payload of a packet has to be received into, after its header has been read. The
+     *        buffer becomes a slot of the queue without being copied (IMA-ADPCM is decoded in place). Then call
+     *        commitPayload().
+     * 
+     * @param h packet header
+     * @param size packet size in bytes, including the header
+     * @return uint8_t* receive buffer for size - OPENREMJAM_HEADER_SIZE bytes, nullptr if the packet is rejected
+     */
+    uint8_t *getPayloadBuffer(const openremjam_header_t &h, uint32_t size);
+
+    /**
+     * @brief Enqueue the packet whose payload has been received into getPayloadBuffer(). A FEC parity packet rebuilds
+     *        the network block of its group that is missing, if it is the only one and not yet due to play.
+     * 
+     * @param h packet header
+     */
+    void commitPayload(const openremjam_header_t &h);
+
+    /**
+     * @brief Echo the latest timestamp received from the remote host in a packet we send to it, so it can measure
+     *        the round trip time
      * 
-     * @param buffer source buffer
+     * @param h header of the packet
      */
-    void enqueue(uint8_t* buffer);
+    void fillEcho(openremjam_header_t &h);
 
     /**
      * @brief Dequeue the oldest network packet from this queue
@@ -150,12 +225,126 @@ class NetworkJitterBufferPlayQueue : public AudioStream {
      */
     int32_t getQueueLength();
 
+    /**
+     * @brief Get the count of packets that arrived too late to be enqueued
+     * 
+     * @return uint32_t count
+     */
+    uint32_t getLatePackets();
+
+    /**
+     * @brief Get the count of packets that arrived too early to be enqueued
+     * 
+     * @return uint32_t count
+     */
+    uint32_t getEarlyPackets();
+
+    /**
+     * @brief Get the count of successful sync recoveries
+     * 
+     * @return uint32_t count
+     */
+    uint32_t getRecoveriesSuccess();
+
+    /**
+     * @brief Get the count of failed sync recoveries (timeouts)
+     * 
+     * @return uint32_t count
+     */
+    uint32_t getRecoveriesFailed();
+
+    /**
+     * @brief Get the count of network blocks synthesized by packet loss concealment
+     * 
+     * @return uint32_t count
+     */
+    uint32_t getConcealedPackets();
+
+    /**
+     * @brief Get the count of packets rejected because they do not match the stream of this queue
+     * 
+     * @return uint32_t count
+     */
+    uint32_t getRejectedPackets();
+
+    /**
+     * @brief Get the count of network blocks rebuilt from parity packets
+     * 
+     * @return uint32_t count
+     */
+    uint32_t getFecRecoveredPackets();
+
+    /**
+     * @brief Get the round trip time to the remote host, measured from the timestamps it echoes
+     * 
+     * @return const RunningStat& min/avg/max in microseconds
+     */
+    const RunningStat &getRtt();
+
+    /**
+     * @brief Get the buffering delay: time from the arrival of a network block until its first sample is played
+     * 
+     * @return const RunningStat& min/avg/max in microseconds
+     */
+    const RunningStat &getBufferingDelay();
+
+    /**
+     * @brief Get the total (mouth-to-ear) latency of the first sample of a network block: packetization at the sender,
+     *        estimated one-way delay (RTT / 2), buffering delay and one audio block of output
+     * 
+     * @return const RunningStat& min/avg/max in microseconds
+     */
+    const RunningStat &getLatency();
+
+    /**
+     * @brief Get the CPU accounting of the receive path of this queue in loop() (getPayloadBuffer(), reading the
+     *        payload, commitPayload()), timed by the caller. update() is accounted by the audio library, see
+     *        processorUsage().
+     * 
+     * @return CpuMeter& 
+     */
+    CpuMeter &getEnqueueCpu();
+
+    /**
+     * @brief Get a percentile of the jitter histogram
+     * 
+     * @param p fraction, e.g. 0.99
+     * @return uint32_t jitter in microseconds, see Histogram::getPercentile()
+     */
+    uint32_t getJitterPercentile(float p);
+
+    /**
+     * @brief Copy the histograms consistently, i.e. without an audio update in between
+     * 
+     * @param snapshot destination
+     */
+    void snapshotHistograms(queue_histograms_t &snapshot);
+
+    /**
+     * @brief Reset the histograms
+     * 
+     */
+    void resetHistograms();
+
+    /**
+     * @brief Print the histograms
+     * 
+     */
+    void printHistograms();
+
     /**
      * @brief Print statistic information
      * 
      */
     void printStatistics();
 
+    /**
+     * @brief Print the statistics, if update() has played another 10000 audio blocks since they were printed last.
+     *        Call from loop(): printing is too slow for the audio interrupt.
+     * 
+     */
+    void printStatisticsIfDue();
+
     /**
      * @brief Resets statistics 
      * 
@@ -176,6 +365,84 @@ class NetworkJitterBufferPlayQueue : public AudioStream {
      */
     uint8_t getMaxBuffers();
 
+    /**
+     * @brief Get the number of slots (upper limit of max_buffers)
+     * 
+     * @return uint32_t count
+     */
+    uint32_t getCapacity();
+
+    /**
+     * @brief Set the number of slots. Only while the queue is stopped (not connected): a pooled queue borrows that
+     *        many slots (plus the receive buffer) when it is connected. max_buffers is reduced if it exceeds the
+     *        capacity.
+     * 
+     * @param n power of two, 2...getMaxCapacity()
+     * @return boolean false if n is invalid or the queue is not stopped
+     */
+    boolean setCapacity(uint32_t n);
+
+    /**
+     * @brief Get the largest capacity of this queue (its slot pointers, see setCapacity())
+     * 
+     * @return uint32_t count
+     */
+    uint32_t getMaxCapacity();
+
+    /**
+     * @brief Is n a valid capacity of this queue: a power of two, 2...getMaxCapacity()?
+     * 
+     * @param n number of slots
+     * @return boolean 
+     */
+    boolean isValidCapacity(uint32_t n);
+
+    /**
+     * @brief Could the queue get n slots if it were restarted now? A pooled queue needs n slots (plus the receive
+     *        buffer) from the block pool, its own slots count as free.
+     * 
+     * @param n number of slots
+     * @return boolean 
+     */
+    virtual boolean canAcquireSlots(uint32_t n) { return true; }
+
+    /**
+     * @brief Does the queue have its slots? A pooled queue has them only while it is connected, and not if the
+     *        block pool had too few free slots when it was connected.
+     * 
+     * @return boolean 
+     */
+    boolean hasSlots();
+
+    /**
+     * @brief Get the number of audio blocks per network block the remote host sends
+     * 
+     * @return uint32_t count
+     */
+    uint32_t getBlocksPerPacket();
+
+    /**
+     * @brief Get the size of the packets this queue receives
+     * 
+     * @param c codec
+     * @return uint32_t size in bytes, including the header
+     */
+    uint32_t getPacketSize(Codec c = Codec::pcm);
+
+    /**
+     * @brief Set the codec of the packets we send to the remote host of this queue
+     * 
+     * @param c codec
+     */
+    void setSendCodec(Codec c);
+
+    /**
+     * @brief Get the codec of the packets we send to the remote host of this queue
+     * 
+     * @return Codec 
+     */
+    Codec getSendCodec();
+
     /**
      * @brief Set the number of network blocks to be queued, before playback starts
      * 
@@ -191,11 +458,135 @@ class NetworkJitterBufferPlayQueue : public AudioStream {
     uint8_t getPrefill();
 
     /**
-     * @brief This is the update function of this auto output stream (plays one audio block)
+     * @brief Enable or disable the adaptive mode. In adaptive mode, the prefill (target queue length) follows the
+     *        measured inter-arrival jitter and the rate of late packets and recoveries. max_buffers becomes the upper limit.
+     * 
+     * @param val true: adaptive, false: fixed prefill
+     */
+    void setAdaptive(boolean val);
+
+    /**
+     * @brief Is the adaptive mode enabled?
+     * 
+     * @return boolean 
+     */
+    boolean getAdaptive();
+
+    /**
+     * @brief Set the tolerated rate of late packets and recoveries in adaptive mode
+     * 
+     * @param val events per 10000 network blocks
+     */
+    void setAdaptiveMaxEventRate(uint16_t val);
+
+    /**
+     * @brief Get the tolerated rate of late packets and recoveries in adaptive mode
+     * 
+     * @return uint16_t events per 10000 network blocks
+     */
+    uint16_t getAdaptiveMaxEventRate();
+
+    /**
+     * @brief Get the estimated inter-arrival jitter (RFC 3550 style running average)
+     * 
+     * @return uint32_t jitter in microseconds
+     */
+    uint32_t getJitter();
+
+    /**
+     * @brief Enable or disable the clock drift compensation. The queue estimates the ratio of the sender's and our
+     *        sampling clock from the trend of the buffer level and resamples the stream accordingly, so the buffer
+     *        level stays steady and no recovery is needed.
+     * 
+     * @param val true: compensate drift, false: play samples as received
+     */
+    void setDriftCompensation(boolean val);
+
+    /**
+     * @brief Is the clock drift compensation enabled?
+     * 
+     * @return boolean 
+     */
+    boolean getDriftCompensation();
+
+    /**
+     * @brief Get the current sample rate correction of the resampler
+     * 
+     * @return float correction in ppm (positive: we play faster than nominal)
+     */
+    float getDriftPpm();
+
+    /**
+     * @brief Start from a known operating point, e.g. the one PeerStore saved for the remote host: prefill, jitter
+     *        estimate and clock drift correction. The estimates go on from there instead of from zero. Call right
+     *        after connecting, stopping the queue resets them.
+     * 
+     * @param val prefill block count, 1...max_buffers (other values keep the prefill)
+     * @param jitter_us inter-arrival jitter in microseconds, see getJitter()
+     * @param drift_ppm sample rate correction in ppm, see getDriftPpm() (ignored without drift compensation)
+     */
+    void warmStart(uint8_t val, uint32_t jitter_us, float drift_ppm);
+
+    /**
+     * @brief Is the queue playing (not stopped, syncing or recovering)?
+     * 
+     * @return boolean 
+     */
+    boolean isPlaying();
+
+    /**
+     * @brief This is the update function of this auto output stream (plays one audio block). Only called while the
+     *        queue is playing or recovering, the queue clears the AudioStream active flag otherwise.
      * 
      */
     virtual void update(void);
 
+  protected:
+
+    /**
+     * @brief Construct a new NetworkJitterBufferPlayQueue object
+     * 
+     * @param capacity number of slots, power of two
+     * @param blocks audio blocks per network block
+     * @param max_cap largest capacity (see setCapacity()), 0: capacity
+     */
+    NetworkJitterBufferPlayQueue(uint32_t capacity, uint32_t blocks, uint32_t max_cap = 0);
+
+    /**
+     * @brief Hand the slot memory to the queue
+     * 
+     * @param storage max_capacity + 1 slots (one is the receive buffer)
+     * @param slots max_capacity slot pointers
+     */
+    void setStorage(int16_t * storage, int16_t ** slots);
+
+    /**
+     * @brief Hand borrowed slots to the queue: they are cleared and the ring starts over
+     * 
+     * @param slots capacity slot pointers, followed by the receive buffer
+     */
+    void attachSlots(int16_t ** slots);
+
+    /**
+     * @brief Take the slots away from the queue (while it is stopped)
+     * 
+     * @return int16_t** the slot pointers of attachSlots(), followed by the receive buffer (capacity + 1 pointers)
+     */
+    int16_t **detachSlots();
+
+    /**
+     * @brief Called when the queue leaves state stopped: get the slots, see attachSlots()
+     * 
+     * @return boolean false if there are none, the queue stays stopped
+     */
+    virtual boolean acquireSlots() { return true; }
+
+    /**
+     * @brief Called when the queue has stopped: give the slots back, see detachSlots()
+     * 
+     */
+    virtual void releaseSlots() {}
+
   private:
 
     /**
@@ -212,13 +603,22 @@ class NetworkJitterBufferPlayQueue : public AudioStream {
     State state;
 
     fnet_sockaddr sa; // port #, IP version, IPv4 or IPv6 address -- this struct has it all :-)
-    network_block_t queue[OPENREMJAM_PLAY_QUEUE_MAX_LENGTH];
-    int32_t max_buffers;          // used number of elements of the queue
+    Codec send_codec;             // codec of the packets we send to the remote host
+    int16_t **queue;              // ring of slots, received packets are swapped in, not copied
+    int16_t *spare;               // receive buffer, not part of the ring
+    uint32_t capacity_mask;       // number of slots - 1
+    uint32_t max_capacity;        // slot pointers of the ring
+    uint32_t blocks_per_packet;   // audio blocks per network block
+    uint32_t samples_per_packet;
+    uint32_t packet_duration_us;
+    int32_t max_buffers;          // maximum queue length + 1
     int32_t prefill;              // fill prefill blocks before start playing or after underrun
 
     uint32_t free_head;           // this index points to the first free element that can be filled with new data
     uint32_t used_tail;           // this index currently used for playing
     uint32_t subindex;            // [0...UNISON_AUDIO_BLOCKS_PER_NETWORK_BLOCK-1], point to the portion of data to be played next
+    uint32_t read_index;          // [0...OPENREMJAM_SAMPLES_PER_NETWORK_BLOCK-1], sample to be played next (drift compensation)
+    uint32_t read_frac;           // fractional part of the read position, unit 2^-32 samples
 
                                   // statistics:
     uint32_t count;               // count played audio blocks
@@ -226,18 +626,129 @@ class NetworkJitterBufferPlayQueue : public AudioStream {
     uint32_t early_packets;       // increment, if an incoming packet has a too big seqno to be enqueued
     uint32_t recoveries_success;  // increment, if sync recovery has been successful
     uint32_t recoveries_failed;   // increment, if sync recovery has failed (after timeout)
+    uint32_t concealed_packets;   // increment, if a missing network block is concealed
+    uint32_t fec_recovered_packets; // increment, if a missing network block is rebuilt from a parity packet
+    uint32_t rejected_packets;    // increment, if a packet does not match the stream of this queue
+    volatile boolean statistics_due; // set by update() every 10000 audio blocks
     
     uint32_t recoveryStart;       // timestamp of entering state recovery in millis
 
+                                  // latency:
+    uint32_t echo_timestamp;      // latest timestamp received from the remote host, echoed back to it
+    uint32_t echo_received;       // our micros() when it was received
+    uint32_t one_way_delay;       // latest round trip time / 2 in microseconds, 0: not measured yet
+    RunningStat rtt;
+    RunningStat buffering_delay;
+    RunningStat latency;
+    queue_histograms_t histograms;
+    CpuMeter enqueue_cpu;
+
+                                  // adaptive mode:
+    boolean adaptive;             // adapt prefill at runtime
+    uint16_t adaptive_max_event_rate; // tolerated late packets + recoveries per 10000 network blocks
+    uint32_t jitter;              // inter-arrival jitter estimate in microseconds, scaled by 16
+    uint32_t last_arrival;        // receive timestamp of the last in-order packet
+    uint32_t last_arrival_seqno;  // its seqno
+    boolean last_arrival_valid;
+    int32_t depth_margin;         // extra blocks on top of the jitter based depth, raised on events, lowered when quiet
+    uint32_t window_blocks;       // network blocks played in the current adaptation window
+    uint32_t window_events;       // late_packets + recoveries at the start of the current window
+    int32_t window_min_length;    // minimum queue length at block boundaries in the current window
+    uint32_t quiet_windows;       // consecutive windows without events
+
+                                  // drift compensation:
+    boolean drift_compensation;   // resample to keep the buffer level steady
+    int32_t step_delta;           // read position increment per sample minus 1.0, unit 2^-32 samples
+    float level_avg;              // smoothed buffer level in samples, measured at packet arrival
+    float level_setpoint;         // buffer level to hold
+    float drift_integral;         // integral part of the rate correction = clock ratio estimate - 1
+    uint32_t settle_packets;      // packets averaged since (re)start of playback
+
+    PacketLossConcealer plc;      // conceals underruns (recovering state), used by update()
+    boolean plc_active;           // plc output is being played, crossfade when real audio resumes
+
     fnet_char_t ipv6_print_buffer[FNET_IP6_ADDR_STR_SIZE];
 
     // helper functions:
-    void placePacketIntoIndex(network_block_t * packet, uint32_t index); // just put the packet into index, if packet==NULL: generate empty packet
-    void placePacketIntoFreeHead(network_block_t * packet); // places a packet at queue[free_head] and advance FreeHead;
+    void placePacketIntoIndex(int16_t * packet, uint32_t index); // swap the receive buffer (packet) into index, if packet==NULL: generate concealed packet
+    uint32_t gatherHistory(uint32_t index, int16_t * history); // copy the audio preceding index, returns the number of samples
+    void placePacketIntoFreeHead(int16_t * packet); // places a packet at queue[free_head] and advance FreeHead;
+    void commitReceived(uint32_t seqno); // enqueue the received packet in the receive buffer
+    void commitParity(uint32_t first, uint32_t group); // rebuild a missing block from the parity in the receive buffer
+    void placeReceiveBuffer();    // enqueue the packet in the receive buffer according to its seqno
+    uint8_t *getCompressedPayloadBuffer(); // end of the receive buffer, IMA-ADPCM is decoded in place
+    int32_t findReceived(uint32_t seqno); // index of the slot holding the received packet seqno, -1 if there is none
     uint32_t nextIndex(uint32_t index);
     uint32_t prevIndex(uint32_t index);
     uint32_t nthIndexAfter(uint32_t index, uint32_t n);
     bool checkPacketContinuityWithPrevious(uint32_t index);
+    int32_t getMaxQueueLength();
+    int16_t *samplesAt(uint32_t index) { return queue[index]; }
+    network_block_info_t *infoAt(uint32_t index) { return (network_block_info_t *)&queue[index][samples_per_packet]; }
     void switchState(State s);
     bool recoveryTimeout();
+    void estimateJitter(network_block_info_t * packet);
+    void measureRtt(const openremjam_header_t &h);
+    void measureLatency(int32_t seqno_delta); // the block seqno_delta blocks after used_tail has just been placed
+    void adaptDepth();
+    void estimateDrift();
+    bool advanceNetworkBlock();
+    void playResampled(int16_t * out);
 };
+
+/**
+ * @brief Play queue with its slots. Capacity (power of two, upper limit of max_buffers) and audio blocks per network block
+ *        are chosen per queue, e.g. a deep queue for a distant peer and a shallow one on the LAN.
+ * 
+ * @tparam CAPACITY number of slots
+ * @tparam BLOCKS audio blocks per network block the remote host sends
+ */
+template <uint32_t CAPACITY, uint32_t BLOCKS>
+class NetworkJitterBufferRing : public NetworkJitterBufferPlayQueue {
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+    static_assert((AUDIO_BLOCK_SAMPLES * BLOCKS) % 2 == 0, "slots must be 32 bit aligned");
+  public:
+    NetworkJitterBufferRing() : NetworkJitterBufferPlayQueue(CAPACITY, BLOCKS) { setStorage(storage, slots); }
+
+  private:
+    static const uint32_t slot_words = AUDIO_BLOCK_SAMPLES * BLOCKS + sizeof(network_block_info_t) / sizeof(int16_t);
+    int16_t storage[(CAPACITY + 1) * slot_words] __attribute__((aligned(4)));
+    int16_t *slots[CAPACITY];
+};
+
+/**
+ * @brief Play queue that borrows its slots from NetworkBlockPool while it is connected. Its capacity can be changed
+ *        at runtime up to MAX_CAPACITY (see setCapacity()), e.g. a deep queue for a distant peer, paid for by the
+ *        pool instead of every queue. Starts with OPENREMJAM_PLAY_QUEUE_SIZE slots (or MAX_CAPACITY if less).
+ * 
+ * @tparam MAX_CAPACITY largest number of slots
+ * @tparam BLOCKS audio blocks per network block the remote host sends, at most OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK (the size of a pool slot)
+ */
+template <uint32_t MAX_CAPACITY, uint32_t BLOCKS>
+class NetworkJitterBufferPooledRing : public NetworkJitterBufferPlayQueue {
+    static_assert(MAX_CAPACITY >= 2 && (MAX_CAPACITY & (MAX_CAPACITY - 1)) == 0, "MAX_CAPACITY must be a power of two");
+    static_assert(BLOCKS <= OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK, "pool slots hold OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK audio blocks");
+    static_assert((AUDIO_BLOCK_SAMPLES * BLOCKS) % 2 == 0, "slots must be 32 bit aligned");
+  public:
+    NetworkJitterBufferPooledRing()
+        : NetworkJitterBufferPlayQueue(OPENREMJAM_PLAY_QUEUE_SIZE < MAX_CAPACITY ? OPENREMJAM_PLAY_QUEUE_SIZE : MAX_CAPACITY, BLOCKS, MAX_CAPACITY),
+          slots{} {}
+
+    virtual boolean canAcquireSlots(uint32_t n) {
+      return NetworkBlockPool::getFree() + (hasSlots() ? getCapacity() + 1 : 0) >= n + 1;
+    }
+
+  protected:
+    virtual boolean acquireSlots() {
+      if (!NetworkBlockPool::allocate(slots, getCapacity() + 1)) return false;
+      attachSlots(slots);
+      return true;
+    }
+
+    virtual void releaseSlots() { NetworkBlockPool::release(detachSlots(), getCapacity() + 1); }
+
+  private:
+    int16_t *slots[MAX_CAPACITY + 1];
+};
+
+typedef NetworkJitterBufferPooledRing<OPENREMJAM_PLAY_QUEUE_MAX_SIZE, OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK> DefaultNetworkJitterBufferPlayQueue;
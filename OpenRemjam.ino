@@ -9,16 +9,31 @@
 #include <CmdCallback.hpp>
 #include "NetworkJitterBufferPlayQueue.h"
 #include "QueueController.h"
+#include "FecEncoder.h"
+#include "FanoutSender.h"
+#include "ControlEndpoint.h"
+#include "Benchmark.h"
+#include "CpuMeter.h"
+#include "PeerStore.h"
+#include "InputMonitor.h"
 
 // Command line helpers:
 CmdParser myParser;
 CmdBuffer<64> myBuffer;
-CmdCallback<4> myCallback;
+CmdCallback<14> myCallback;
 
-EthernetUDP Udp;
+FnetUDP Udp;
 
-uint8_t recv_buf[2*OPENREMJAM_MONO_PACKET_SIZE];
-uint8_t send_buf[OPENREMJAM_MONO_PACKET_SIZE]; 
+// header, followed by the samples (aligned for the header and the parity computation):
+uint8_t send_buf[OPENREMJAM_MONO_PACKET_SIZE] __attribute__((aligned(4)));
+openremjam_header_t *send_header = (openremjam_header_t *)send_buf;
+
+// the same network block for remote hosts that receive IMA-ADPCM from us (encoded once for all of them):
+uint8_t adpcm_buf[OPENREMJAM_MONO_ADPCM_PACKET_SIZE] __attribute__((aligned(4)));
+ima_adpcm_state_t adpcm_state = {0, 0};
+
+// forward error correction: one XOR parity packet per group of network blocks
+FecEncoder fec;
 
 // set up audio input:
 AudioControlSGTL5000 shield;
@@ -29,12 +44,43 @@ AudioRecordQueue rec_queue;
 AudioConnection input_to_mixer_0(i2s_in, 0, input_mixer, 0);
 AudioConnection input_to_mixer_1(i2s_in, 1, input_mixer, 1);
 AudioConnection mixer_to_rec_queue(input_mixer, rec_queue);
+// counts the input blocks, so those lost before rec_queue or dropped by it are reported:
+InputMonitor input_monitor;
+AudioConnection mixer_to_input_monitor(input_mixer, input_monitor);
 
 // MAC address:
 byte mac[6];
 
+// play queues, one per remote host. They borrow their slots from NetworkBlockPool while connected, and their
+// capacity can be changed at runtime (CAPACITY command), e.g. a deep queue for a distant peer. Queues can also be
+// of different types, e.g. NetworkJitterBufferRing<8, OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK> keeps its slots in
+// the queue (RAM1) for the loopback queue (pass an array of OPENREMJAM_MAX_PEERS queue pointers to QueueController then):
+DefaultNetworkJitterBufferPlayQueue play_queue[OPENREMJAM_MAX_PEERS];
+
 // qc cares for audio output:
-QueueController qc;
+QueueController qc(play_queue);
+
+// sends our packets to all remote hosts:
+FanoutSender sender(qc);
+
+// telemetry and control on OPENREMJAM_CONTROL_UDP_PORT (see host/ctl/openremjam-ctl):
+ControlEndpoint control(qc);
+
+// remembers the remote hosts and their last good operating point in EEPROM (STORE command):
+PeerStore store(qc);
+
+// CPU accounting of the loop() stages (the send fan-out is accounted by sender, the audio interrupt by the audio library):
+CpuMeter capture_cpu;   // packetizing, IMA-ADPCM encoding and FEC parity of our signal
+CpuMeter receive_cpu;   // receivePackets() as a whole: socket, queue lookup and the queues' receive paths
+CpuMeter loop_cpu;      // all of loop(): its longest iteration is what rec_queue has to hold (OPENREMJAM_LOOP_STALL_MAX_US)
+
+// input blocks loop() has read from rec_queue, and the input losses at startup and at the last report (see reportInputLoss())
+uint32_t input_read = 0;
+uint32_t input_dropped_start = 0;
+uint32_t input_missing_start = 0;
+uint32_t input_dropped_reported = 0;
+uint32_t input_missing_reported = 0;
+uint32_t input_reported = 0; // millis()
 
 // subindex is the position of an audio block within a network block
 int subindex = 0;
@@ -42,6 +88,38 @@ int subindex = 0;
 // seqno is the sequence number of a network block. The receiver uses it for detecting packet loss and reordering.
 uint32_t seqno = 0;
 
+// millis() of the last autoconnect that failed for lack of block pool slots: the next attempt waits a second
+uint32_t autoconnect_failed = 0;
+boolean autoconnect_failed_valid = false;
+
+// input blocks rec_queue has dropped since startup because loop() stalled longer than its backlog
+uint32_t getInputDropped() {
+  AudioNoInterrupts();
+  uint32_t n = input_monitor.getBlocks() - input_read - rec_queue.available();
+  AudioInterrupts();
+  return n - input_dropped_start;
+}
+
+// audio cycles since startup without an input block: the audio memory was exhausted
+uint32_t getInputMissing() {
+  return input_monitor.getMissing() - input_missing_start;
+}
+
+// warn about lost input, at most once a second
+void reportInputLoss() {
+  if (millis() - input_reported < 1000) return;
+  uint32_t dropped = getInputDropped();
+  uint32_t missing = getInputMissing();
+  if (dropped != input_dropped_reported || missing != input_missing_reported) {
+    Serial.printf("*** WARNING: input lost: %lu blocks dropped by rec_queue (longest loop() %.1f us, backlog %d us), %lu missing (audio memory peak %d of %d blocks) ***\r\n",
+                  dropped - input_dropped_reported, loop_cpu.getCallMaxUs(), OPENREMJAM_LOOP_STALL_MAX_US, missing - input_missing_reported,
+                  AudioMemoryUsageMax(), OPENREMJAM_AUDIO_MEMORY);
+    input_dropped_reported = dropped;
+    input_missing_reported = missing;
+  }
+  input_reported = millis();
+}
+
 void functConnect(CmdParser *myParser) {
   String idString(myParser->getCmdParam(1));
   String ipString(myParser->getCmdParam(2));
@@ -51,12 +129,14 @@ void functConnect(CmdParser *myParser) {
   IPAddress ip;
   int port = portString.toInt();
   
-  if (id < 0 || id > 15 || !ip.fromString(ipString) || port > 65535 || port < 1) {
+  if (id < 0 || id >= OPENREMJAM_MAX_PEERS || !ip.fromString(ipString) || port > 65535 || port < 1) {
     Serial.println("Syntax: connect <id> <ip> <port>");
-    Serial.println("<id> must be in range 0...15, <ip> must be a valid IPv4 address, port must be in range 1...65535");
+    Serial.printf("<id> must be in range 0...%d, <ip> must be a valid IPv4 address, port must be in range 1...65535\r\n", OPENREMJAM_MAX_PEERS - 1);
     Serial.println("Example: connect 0 192.168.178.20 9000");
+  } else if (!qc.connect(id, ip, port)) {
+    Serial.printf("Queue %d: not connected, not enough free slots in the block pool\r\n", id);
+    NetworkBlockPool::printInfo();
   } else {
-    qc.connect(id, ip, port);
     Serial.printf("Queue %d: connected to %2d.%2d.%2d.%2d:%d\r\n", id, ip[0], ip[1], ip[2], ip[3], port);
   }
 }
@@ -64,9 +144,9 @@ void functConnect(CmdParser *myParser) {
 void functDisconnect(CmdParser *myParser) {
   String idString(myParser->getCmdParam(1));
   int id = idString.toInt();
-  if (id < 0 || id > 15) {
+  if (id < 0 || id >= OPENREMJAM_MAX_PEERS) {
     Serial.println("Syntax: disconnect <id>");
-    Serial.println("<id> must be in range 0...15");
+    Serial.printf("<id> must be in range 0...%d\r\n", OPENREMJAM_MAX_PEERS - 1);
     Serial.println("Example: disconnect 0");
   } else {
     qc.disconnect(id);
@@ -74,10 +154,178 @@ void functDisconnect(CmdParser *myParser) {
   }
 }
 
+void functAdaptive(CmdParser *myParser) {
+  String idString(myParser->getCmdParam(1));
+  String valString(myParser->getCmdParam(2));
+  int id = idString.toInt();
+  int val = valString.toInt();
+  if (id < 0 || id >= OPENREMJAM_MAX_PEERS || val < 0 || val > 1 || valString.length() == 0) {
+    Serial.println("Syntax: adaptive <id> <0|1>");
+    Serial.printf("<id> must be in range 0...%d, 1 enables and 0 disables the adaptive buffer depth\r\n", OPENREMJAM_MAX_PEERS - 1);
+    Serial.println("Example: adaptive 1 1");
+  } else {
+    qc.getQueue(id)->setAdaptive(val);
+    Serial.printf("Queue %d: adaptive buffer depth %s\r\n", id, val ? "enabled" : "disabled");
+  }
+}
+
+void functCapacity(CmdParser *myParser) {
+  String idString(myParser->getCmdParam(1));
+  String valString(myParser->getCmdParam(2));
+  int id = idString.toInt();
+  int val = valString.toInt();
+  if (id < 0 || id >= OPENREMJAM_MAX_PEERS || valString.length() == 0 || val < 2 || !qc.getQueue(id)->isValidCapacity(val)) {
+    Serial.println("Syntax: capacity <id> <slots>");
+    Serial.printf("<id> must be in range 0...%d, <slots> must be a power of two in range 2...%d. A connected queue restarts\r\n",
+                  OPENREMJAM_MAX_PEERS - 1, OPENREMJAM_PLAY_QUEUE_MAX_SIZE);
+    Serial.println("Example: capacity 1 16");
+  } else if (!qc.setCapacity(id, val)) {
+    Serial.printf("Queue %d: not enough free slots in the block pool\r\n", id);
+    NetworkBlockPool::printInfo();
+  } else {
+    Serial.printf("Queue %d: capacity %d\r\n", id, val);
+  }
+}
+
+void functDrift(CmdParser *myParser) {
+  String idString(myParser->getCmdParam(1));
+  String valString(myParser->getCmdParam(2));
+  int id = idString.toInt();
+  int val = valString.toInt();
+  if (id < 0 || id >= OPENREMJAM_MAX_PEERS || val < 0 || val > 1 || valString.length() == 0) {
+    Serial.println("Syntax: drift <id> <0|1>");
+    Serial.printf("<id> must be in range 0...%d, 1 enables and 0 disables the clock drift compensation\r\n", OPENREMJAM_MAX_PEERS - 1);
+    Serial.println("Example: drift 1 0");
+  } else {
+    qc.getQueue(id)->setDriftCompensation(val);
+    Serial.printf("Queue %d: clock drift compensation %s\r\n", id, val ? "enabled" : "disabled");
+  }
+}
+
+void functFec(CmdParser *myParser) {
+  String valString(myParser->getCmdParam(1));
+  int val = valString.toInt();
+  if (valString.length() == 0 || val < 0 || !fec.setGroup(val)) {
+    Serial.println("Syntax: fec <k>");
+    Serial.printf("Sends one parity packet per <k> network blocks, <k> must be 0 (off) or in range 2...%d\r\n", OPENREMJAM_FEC_MAX_GROUP);
+    Serial.println("Example: fec 4");
+  } else if (val) {
+    Serial.printf("FEC: one parity packet per %d network blocks\r\n", val);
+  } else {
+    Serial.println("FEC: disabled");
+  }
+}
+
+void functCodec(CmdParser *myParser) {
+  String idString(myParser->getCmdParam(1));
+  String codecString(myParser->getCmdParam(2));
+  int id = idString.toInt();
+  boolean adpcm = codecString.equalsIgnoreCase("adpcm");
+  if (id < 0 || id >= OPENREMJAM_MAX_PEERS || (!adpcm && !codecString.equalsIgnoreCase("pcm"))) {
+    Serial.println("Syntax: codec <id> <pcm|adpcm>");
+    Serial.printf("<id> must be in range 0...%d, adpcm sends 4 bit IMA-ADPCM instead of 16 bit PCM to the remote host\r\n", OPENREMJAM_MAX_PEERS - 1);
+    Serial.println("Example: codec 1 adpcm");
+  } else {
+    qc.getQueue(id)->setSendCodec(adpcm ? Codec::adpcm : Codec::pcm);
+    Serial.printf("Queue %d: sending %s\r\n", id, adpcm ? "IMA-ADPCM" : "PCM");
+  }
+}
+
+void functMulticast(CmdParser *myParser) {
+  String ipString(myParser->getCmdParam(1));
+  IPAddress ip;
+  if (ipString.equalsIgnoreCase("off")) ip = IPAddress(0, 0, 0, 0);
+  else if (!ip.fromString(ipString)) ip = IPAddress(255, 255, 255, 255); // invalid
+  if (!sender.setMulticast(ip)) {
+    Serial.println("Syntax: multicast <ip|off>");
+    Serial.println("<ip> must be an IPv4 multicast group (224.0.0.0...239.255.255.255), off sends to each remote host");
+    Serial.println("Example: multicast 239.0.0.42");
+  } else if (ip != IPAddress(0, 0, 0, 0)) {
+    Serial.printf("Multicast: sending to and receiving from group %d.%d.%d.%d\r\n", ip[0], ip[1], ip[2], ip[3]);
+  } else {
+    Serial.println("Multicast: disabled");
+  }
+}
+
+void functHist(CmdParser *myParser) {
+  String idString(myParser->getCmdParam(1));
+  String resetString(myParser->getCmdParam(2));
+  int id = idString.toInt();
+  if (id < 0 || id >= OPENREMJAM_MAX_PEERS || idString.length() == 0 || (resetString.length() && !resetString.equalsIgnoreCase("reset"))) {
+    Serial.println("Syntax: hist <id> [reset]");
+    Serial.printf("<id> must be in range 0...%d, reset clears the histograms after printing them\r\n", OPENREMJAM_MAX_PEERS - 1);
+    Serial.println("Example: hist 1");
+  } else {
+    Serial.printf("Queue %d:\r\n", id);
+    qc.getQueue(id)->printHistograms();
+    if (resetString.length()) qc.getQueue(id)->resetHistograms();
+  }
+}
+
+void functServer(CmdParser *myParser) {
+  String valString(myParser->getCmdParam(1));
+  int val = valString.toInt();
+  if (val < 0 || val > 1 || valString.length() == 0) {
+    Serial.println("Syntax: server <0|1>");
+    Serial.println("1 sends each remote host the mix of all other queues (mix-minus) instead of our signal, 0 sends our signal to everybody");
+    Serial.println("Example: server 1");
+  } else {
+    qc.setServerMode(val);
+    Serial.printf("Server mode %s\r\n", val ? "enabled" : "disabled");
+  }
+}
+
+void functCpu(CmdParser *myParser) {
+  String resetString(myParser->getCmdParam(1));
+  if (resetString.length() && !resetString.equalsIgnoreCase("reset")) {
+    Serial.println("Syntax: cpu [reset]");
+    Serial.println("Prints the CPU usage of each stage, current and peak. reset starts over with the peak values after printing them");
+    Serial.println("Example: cpu");
+    return;
+  }
+  Serial.printf("Audio interrupt (%%):     %.2f (peak %.2f, headroom %.2f)\r\n", AudioProcessorUsage(), AudioProcessorUsageMax(), 100.0f - AudioProcessorUsageMax());
+  Serial.printf("Input (%%):               %.2f (peak %.2f)\r\n",
+                i2s_in.processorUsage() + input_mixer.processorUsage() + rec_queue.processorUsage(),
+                i2s_in.processorUsageMax() + input_mixer.processorUsageMax() + rec_queue.processorUsageMax());
+  qc.printCpuUsage();
+  Serial.printf("Capture (%%):             %.2f (peak %.2f, longest %.1f us)\r\n", capture_cpu.getUsage(), capture_cpu.getUsageMax(), capture_cpu.getCallMaxUs());
+  Serial.printf("Send fan-out (%%):        %.2f (peak %.2f, longest %.1f us)\r\n", sender.getCpu().getUsage(), sender.getCpu().getUsageMax(), sender.getCpu().getCallMaxUs());
+  Serial.printf("Receive (%%):             %.2f (peak %.2f, longest %.1f us)\r\n", receive_cpu.getUsage(), receive_cpu.getUsageMax(), receive_cpu.getCallMaxUs());
+  Serial.printf("Longest loop() (us):     %.1f (input backlog %d us, %lu blocks dropped by rec_queue, %lu missing)\r\n",
+                loop_cpu.getCallMaxUs(), OPENREMJAM_LOOP_STALL_MAX_US, getInputDropped(), getInputMissing());
+  if (resetString.length()) {
+    AudioProcessorUsageMaxReset();
+    i2s_in.processorUsageMaxReset();
+    input_mixer.processorUsageMaxReset();
+    rec_queue.processorUsageMaxReset();
+    qc.resetCpuUsageMax();
+    capture_cpu.resetMax();
+    sender.getCpu().resetMax();
+    receive_cpu.resetMax();
+    loop_cpu.resetMax();
+  }
+}
+
+void functStore(CmdParser *myParser) {
+  String actionString(myParser->getCmdParam(1));
+  if (actionString.equalsIgnoreCase("save")) {
+    store.save();
+  } else if (actionString.equalsIgnoreCase("clear")) {
+    store.clear();
+  } else if (actionString.length()) {
+    Serial.println("Syntax: store [save|clear]");
+    Serial.println("Prints the remote hosts remembered in EEPROM. save writes the operating points of the connected queues now, clear forgets all remote hosts");
+    Serial.println("Example: store save");
+    return;
+  }
+  store.printInfo();
+}
+
 void functShow(CmdParser *myParser) {
-  for (int i=0; i<16; ++i) {
+  for (int i=0; i<OPENREMJAM_MAX_PEERS; ++i) {
     qc.printInfo(i);
   }
+  NetworkBlockPool::printInfo();
 }
 
 void enet_getmac(uint8_t *mac) {
@@ -99,10 +347,29 @@ void setup() {
   myCallback.addCmd("CONNECT", &functConnect);
   myCallback.addCmd("DISCONNECT", &functDisconnect);
   myCallback.addCmd("SHOW", &functShow);
+  myCallback.addCmd("ADAPTIVE", &functAdaptive);
+  myCallback.addCmd("DRIFT", &functDrift);
+  myCallback.addCmd("FEC", &functFec);
+  myCallback.addCmd("MULTICAST", &functMulticast);
+  myCallback.addCmd("CODEC", &functCodec);
+  myCallback.addCmd("HIST", &functHist);
+  myCallback.addCmd("SERVER", &functServer);
+  myCallback.addCmd("CPU", &functCpu);
+  myCallback.addCmd("CAPACITY", &functCapacity);
+  myCallback.addCmd("STORE", &functStore);
   
-  AudioMemory(16 * OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK + 10);    // each of the 16 queues needs up to OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK audio blocks, plus 10 blocks headroom (e.g. for audio input)
+  AudioMemory(OPENREMJAM_AUDIO_MEMORY);    // sized for OPENREMJAM_MAX_PEERS queues, see QueueController.h
   shield.enable();
 
+#if OPENREMJAM_BENCHMARK
+  // measure the hot paths with the queues of qc (see Benchmark.h), then stop
+  while (!Serial && millis() < 5000);
+  AudioNoInterrupts();
+  Benchmark::run(qc);
+  Serial.println("# done");
+  while (1);
+#endif
+
   Serial.println("OpenRemjam – ultra-low latency audio streaming solution for Teensy 4.1");
   
   // print configuration information:
@@ -132,6 +399,8 @@ void setup() {
   }
 
   Udp.begin(OPENREMJAM_DEFAULT_UDP_PORT);
+  sender.begin(Udp.getSocket()); // send from the port we receive on
+  control.begin();
 
   Serial.print("Ethernet adapter is ready! Local IP address: ");
   Serial.println(Ethernet.localIP());
@@ -141,71 +410,138 @@ void setup() {
 
   /********************** Setup queues: ***********************/
   // Loopback (makes you hear your local audio signal)
-  qc.getQueue(0)->setIP(IPAddress(127,0,0,1));
-  qc.getQueue(0)->setPort(OPENREMJAM_DEFAULT_UDP_PORT);
+  qc.connect(0, IPAddress(127,0,0,1), OPENREMJAM_DEFAULT_UDP_PORT);
 
   // Example for remote host:
-  //qc.getQueue(1)->setIP(IPAddress(192,168,178,34));
-  //qc.getQueue(1)->setPort(OPENREMJAM_DEFAULT_UDP_PORT);
+  //qc.connect(1, IPAddress(192,168,178,34), OPENREMJAM_DEFAULT_UDP_PORT);
+
+  // the remote hosts of the last run, on the queues that are still free, each from its last good operating point
+  store.begin();
 
   // start recording samples:
   rec_queue.begin();
+  input_dropped_start = getInputDropped();
+  input_missing_start = getInputMissing();
+}
+
+// receive all pending packets, each straight into the queue of its remote host. Draining the socket (instead of one
+// packet per loop() iteration) keeps packets of several peers that arrive at once from waiting in the stack and
+// showing up as late packets.
+void receivePackets() {
+    int packet_size;
+    openremjam_header_t header;
+    uint32_t t0 = CpuMeter::start();
+    while ((packet_size = Udp.parsePacket()) > 0) {
+        // in multicast mode, the group echoes our own packets
+        if (sender.getMulticast() != IPAddress(0, 0, 0, 0) && Udp.remoteIP() == Ethernet.localIP()) continue;
+        if (packet_size < OPENREMJAM_HEADER_SIZE) continue;
+        Udp.read((uint8_t *)&header, OPENREMJAM_HEADER_SIZE);
+
+        // look up queue index
+        int qi = qc.getQueueIndexByIP(Udp.remoteIP(), Udp.remotePort());
+
+        if (qi < 0) {
+            // we don't have a queue for this remote host, yet.
+            qi = qc.getFreeAutoconnectQueueIndex(); // find a suitable queue!
+            if (autoconnect_failed_valid && millis() - autoconnect_failed < 1000) qi = -1;
+            if (qi >= 0 && header.type == PacketType::audio && qc.getQueue(qi)->isCompatible(header, packet_size)) {
+                if (qc.connect(qi, Udp.remoteIP(), Udp.remotePort())) {
+                    qc.getQueue(qi)->setSendCodec(header.codec); // the remote host understands its own codec: answer in kind
+                } else {
+                    // reported once per attempt, not for every packet of the remote host
+                    IPAddress ip = Udp.remoteIP();
+                    Serial.printf("Autoconnect: %d.%d.%d.%d:%d not connected, not enough free slots in the block pool\r\n",
+                                  ip[0], ip[1], ip[2], ip[3], Udp.remotePort());
+                    autoconnect_failed = millis();
+                    autoconnect_failed_valid = true;
+                    qi = -1;
+                }
+            } else {
+                qi = -1;
+                //Serial.println("No free autoconnect queues!");
+            }
+        }
+
+        // the header matches the queue's stream: receive the payload straight into the queue, it becomes a queue slot
+        // without further copies. Anything else is dropped by the next parsePacket()
+        if (qi < 0) continue;
+        uint32_t t1 = CpuMeter::start();
+        uint8_t *payload = qc.getQueue(qi)->getPayloadBuffer(header, packet_size);
+        if (payload) {
+            Udp.read(payload, packet_size - OPENREMJAM_HEADER_SIZE);
+            qc.getQueue(qi)->commitPayload(header);
+        }
+        qc.getQueue(qi)->getEnqueueCpu().stop(t1);
+    }
+    receive_cpu.stop(t0);
 }
 
 void loop() {
     // Serial.println("Main loop");
+    uint32_t loop_t0 = CpuMeter::start();
     // process locally recorded samples
     if (rec_queue.available() > 0) {
         digitalWrite(13, HIGH);
+        uint32_t t0 = CpuMeter::start();
         uint8_t *bufptr = (uint8_t *)rec_queue.readBuffer();
-        memcpy(&send_buf[subindex*AUDIO_BLOCK_SAMPLES*2], bufptr, AUDIO_BLOCK_SAMPLES *2);
+        memcpy(&send_buf[OPENREMJAM_HEADER_SIZE + subindex*AUDIO_BLOCK_SAMPLES*2], bufptr, AUDIO_BLOCK_SAMPLES *2);
         rec_queue.freeBuffer();
+        input_read++;
         subindex++;
         
         if (subindex == OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK) { // we have one a full packet now!
-            // set seqno:
-            memcpy( &send_buf[subindex*AUDIO_BLOCK_SAMPLES*2], &seqno, 4);
+            // set header (seqno, send time, format):
+            fillHeader(*send_header, PacketType::audio, Codec::pcm, seqno, OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK, fec.getGroup());
             seqno++;
             // we have a new block. Send it to all of our remote hosts:
-            for (int i = 0; i < 16; ++i) {
-                if (qc.getQueue(i)->getPort() != 0) {
-                  Udp.beginPacket(qc.getQueue(i)->getIP(), qc.getQueue(i)->getPort());
-                  Udp.write(send_buf, OPENREMJAM_MONO_PACKET_SIZE);
-                  Udp.endPacket();
-                }
+            capture_cpu.stop(t0);
+            sender.send(send_buf, OPENREMJAM_MONO_PACKET_SIZE, Codec::pcm);
+            // ...and compressed to the remote hosts that receive IMA-ADPCM, if there are any. Each packet starts with
+            // the coder state, so it decodes on its own even if the coder has been idle meanwhile
+            if (sender.hasReceivers(Codec::adpcm)) {
+                t0 = CpuMeter::start();
+                memcpy(adpcm_buf, send_buf, OPENREMJAM_HEADER_SIZE);
+                ((openremjam_header_t *)adpcm_buf)->codec = Codec::adpcm;
+                ImaAdpcm::encode((int16_t *)&send_buf[OPENREMJAM_HEADER_SIZE], OPENREMJAM_SAMPLES_PER_NETWORK_BLOCK,
+                                 &adpcm_buf[OPENREMJAM_HEADER_SIZE], adpcm_state);
+                capture_cpu.stop(t0);
+                sender.send(adpcm_buf, OPENREMJAM_MONO_ADPCM_PACKET_SIZE, Codec::adpcm);
+            }
+            t0 = CpuMeter::start();
+            boolean parity = fec.add(send_buf);
+            capture_cpu.stop(t0);
+            // ...followed by the parity packet, if this block completes a FEC group
+            if (parity) {
+                sender.send(fec.getParityPacket(), OPENREMJAM_MONO_PACKET_SIZE, Codec::pcm); // parity covers PCM packets only
             }
             subindex=0;
+        } else {
+            capture_cpu.stop(t0);
         }
     }
     digitalWrite(13, LOW);
 
-    // receive incomming packets:
-    if (Udp.parsePacket() == OPENREMJAM_MONO_PACKET_SIZE) {
-        // we have received something that looks valid...
+    // server mode: send the clients their mix-minus streams
+    sender.sendMixMinus();
 
-        // look up queue index
-        int qi = qc.getQueueIndexByIP(Udp.remoteIP(), Udp.remotePort());
+    // receive all incoming packets
+    receivePackets();
 
-        if (qi < 0) {
-            // we don't have a queue for this remote host, yet.
-            qi = qc.getFreeAutoconnectQueueIndex(); // find a suitable queue!
-            if (qi >= 0) {
-                qc.getQueue(qi)->setIP(Udp.remoteIP());
-                qc.getQueue(qi)->setPort(Udp.remotePort());
-            } else {
-                //Serial.println("No free autoconnect queues!");
-            }
-        }
+    // print what the audio and network paths have logged meanwhile
+    EventLog::flush();
+    qc.printStatisticsIfDue();
+    reportInputLoss();
 
-        if (qi >= 0) {
-            Udp.read(recv_buf,sizeof(recv_buf));
-            qc.getQueue(qi)->enqueue(recv_buf);
-        }
-    }
+    // telemetry and control requests
+    control.poll();
+
+    // warm start of newly connected queues, saving the operating points that are due
+    store.poll();
 
     // process cmd line input
     myCallback.updateCmdProcessing(&myParser, &myBuffer, &Serial);
 
     // maintain IP configuration using DHCP
     Ethernet.maintain();
+    loop_cpu.stop(loop_t0);
 }
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Audio.h"
+
+// DO NOT CHANGE THESE:
+#define OPENREMJAM_MAGIC (0x4A52)                         // "RJ" (little endian)
+#define OPENREMJAM_PROTOCOL_VERSION (2)
+#define OPENREMJAM_SAMPLE_RATE (44100)
+#define OPENREMJAM_HEADER_SIZE (28)
+
+/**
+ * @brief Codec of the payload
+ *
+ */
+enum class Codec : uint8_t {
+  pcm,      // 16 bit samples
+  adpcm     // IMA-ADPCM, 4 bit per sample, see ImaAdpcm
+};
+
+/**
+ * @brief Kind of packet
+ *
+ */
+enum class PacketType : uint8_t {
+  audio,    // one network block
+  parity    // FEC: XOR of the PCM samples of fec_group network blocks, starting at seqno (see FecEncoder)
+};
+
+/**
+ * @brief Header in front of every packet (little endian). The payload follows: samples, depending on codec.
+ *
+ */
+typedef struct openremjam_header_struct {
+  uint16_t magic;           // OPENREMJAM_MAGIC
+  uint8_t version;          // OPENREMJAM_PROTOCOL_VERSION
+  PacketType type;
+  uint32_t seqno;           // network block number (parity: first block of the group)
+  uint32_t timestamp;       // sender's micros() when the packet was sent, right after its last sample was captured
+  uint32_t sample_rate;     // Hz
+  uint8_t channels;         // 1
+  Codec codec;
+  uint8_t blocks;           // audio blocks (AUDIO_BLOCK_SAMPLES samples each) per network block
+  uint8_t fec_group;        // network blocks per parity packet (0: the sender sends no parity packets)
+  uint32_t echo_timestamp;  // latest timestamp the sender received from the addressee (0: none, e.g. multicast)
+  uint32_t echo_delay;      // microseconds between receiving echo_timestamp and sending this packet
+} openremjam_header_t;
+
+static_assert(sizeof(openremjam_header_t) == OPENREMJAM_HEADER_SIZE, "the header is part of the wire format");
+
+/**
+ * @brief Fill in a header of this firmware's stream
+ *
+ * @param h header
+ * @param type kind of packet
+ * @param codec codec of the payload
+ * @param seqno sequence number
+ * @param blocks audio blocks per network block
+ * @param fec_group network blocks per parity packet, 0: none
+ */
+static inline void fillHeader(openremjam_header_t &h, PacketType type, Codec codec, uint32_t seqno, uint8_t blocks, uint8_t fec_group) {
+  h.magic = OPENREMJAM_MAGIC;
+  h.version = OPENREMJAM_PROTOCOL_VERSION;
+  h.type = type;
+  h.seqno = seqno;
+  h.timestamp = micros();
+  h.sample_rate = OPENREMJAM_SAMPLE_RATE;
+  h.channels = 1;
+  h.codec = codec;
+  h.blocks = blocks;
+  h.fec_group = fec_group;
+  h.echo_timestamp = 0; // filled in per remote host, see NetworkJitterBufferPlayQueue::fillEcho()
+  h.echo_delay = 0;
+}
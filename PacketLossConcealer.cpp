@@ -0,0 +1,72 @@
+#include "PacketLossConcealer.h"
+
+PacketLossConcealer::PacketLossConcealer() : period{}, lag(0), phase(0), gain(0), gain_step(0) {}
+
+uint32_t PacketLossConcealer::estimateLag(const int16_t *history, uint32_t len) {
+    if (len < OPENREMJAM_PLC_WINDOW + OPENREMJAM_PLC_MIN_LAG) {
+        // too little history for a pitch search: repeat all of it
+        return (len > OPENREMJAM_PLC_MAX_LAG) ? OPENREMJAM_PLC_MAX_LAG : len;
+    }
+    uint32_t max_lag = len - OPENREMJAM_PLC_WINDOW;
+    if (max_lag > OPENREMJAM_PLC_MAX_LAG) max_lag = OPENREMJAM_PLC_MAX_LAG;
+
+    // compare the last OPENREMJAM_PLC_WINDOW samples with the same window lag samples earlier
+    // (every other sample only, that is precise enough and halves the cost)
+    const int16_t *window = &history[len - OPENREMJAM_PLC_WINDOW];
+    uint32_t best_lag = max_lag;
+    float best_score = 0;
+    for (uint32_t l = OPENREMJAM_PLC_MIN_LAG; l <= max_lag; ++l) {
+        const int16_t *past = window - l;
+        int64_t corr = 0;
+        int64_t energy = 0;
+        for (uint32_t i = 0; i < OPENREMJAM_PLC_WINDOW; i += 2) {
+            corr += (int32_t)window[i] * past[i];
+            energy += (int32_t)past[i] * past[i];
+        }
+        if (corr > 0 && energy > 0) {
+            float score = (float)corr * (float)corr / (float)energy;
+            if (score > best_score) {
+                best_score = score;
+                best_lag = l;
+            }
+        }
+    }
+    return best_lag;
+}
+
+void PacketLossConcealer::begin(const int16_t *history, uint32_t len, uint32_t fade_samples) {
+    begin(history, len, estimateLag(history, len), fade_samples);
+}
+
+void PacketLossConcealer::begin(const int16_t *history, uint32_t len, uint32_t l, uint32_t fade_samples) {
+    if (!l || l > len) l = len;
+    if (l > OPENREMJAM_PLC_MAX_LAG) l = OPENREMJAM_PLC_MAX_LAG;
+    lag = l;
+    memcpy(period, &history[len - lag], lag * sizeof(int16_t));
+    phase = 0;
+    gain = 1 << 30;
+    gain_step = fade_samples ? (1 << 30) / fade_samples : (1 << 30);
+}
+
+void PacketLossConcealer::synthesize(int16_t *out, uint32_t n) {
+    for (uint32_t i = 0; i < n; ++i) {
+        if (!lag || gain <= 0) {
+            out[i] = 0;
+            continue;
+        }
+        out[i] = (period[phase] * (gain >> 15)) >> 15;
+        if (++phase == lag) phase = 0;
+        gain -= gain_step;
+    }
+}
+
+void PacketLossConcealer::crossfadeInto(int16_t *real, uint32_t n) {
+    int16_t concealed[OPENREMJAM_PLC_CROSSFADE];
+    if (n > OPENREMJAM_PLC_CROSSFADE) n = OPENREMJAM_PLC_CROSSFADE;
+    synthesize(concealed, n);
+    for (uint32_t i = 0; i < n; ++i) {
+        real[i] = ((int32_t)concealed[i] * (int32_t)(n - i) + (int32_t)real[i] * (int32_t)i) / (int32_t)n;
+    }
+}
+
+uint32_t PacketLossConcealer::getLag() { return lag; }
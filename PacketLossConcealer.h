@@ -0,0 +1,87 @@
+#pragma once
+
+#define OPENREMJAM_PLC_MIN_LAG (32)                       // default: 32 (shortest pitch period in samples, ~1.4 kHz)
+#define OPENREMJAM_PLC_MAX_LAG (256)                      // default: 256 (longest pitch period in samples, ~170 Hz)
+#define OPENREMJAM_PLC_WINDOW (64)                        // default: 64 (samples compared per candidate pitch period)
+#define OPENREMJAM_PLC_FADE_BLOCKS (8)                    // default: 8 (concealed network blocks until silence)
+#define OPENREMJAM_PLC_CROSSFADE (32)                     // default: 32 (samples crossfaded from concealed into real audio)
+
+// DO NOT CHANGE THESE:
+#define OPENREMJAM_PLC_HISTORY (OPENREMJAM_PLC_MAX_LAG + OPENREMJAM_PLC_WINDOW)
+
+#include "Audio.h"
+
+/**
+ * @brief Synthesizes replacement audio for lost packets by repeating the last pitch period of the preceding audio,
+ *        fading out over long gaps.
+ *
+ */
+class PacketLossConcealer {
+  public:
+
+    /**
+     * @brief Construct a new PacketLossConcealer object
+     *
+     */
+    PacketLossConcealer(void);
+
+    /**
+     * @brief Start concealment after the given audio: estimate the pitch period and keep the last period. The pitch
+     *        search is too expensive for the audio interrupt, call from loop() only.
+     *
+     * @param history preceding audio, oldest sample first
+     * @param len number of samples in history
+     * @param fade_samples number of samples until the output has faded to silence
+     */
+    void begin(const int16_t *history, uint32_t len, uint32_t fade_samples);
+
+    /**
+     * @brief Start concealment after the given audio with a pitch period estimated before (see estimateLag()): only
+     *        keeps the last period, so it can run in the audio interrupt
+     *
+     * @param history preceding audio, oldest sample first
+     * @param len number of samples in history
+     * @param lag pitch period of history, 0 (or more than len): repeat the end of history
+     * @param fade_samples number of samples until the output has faded to silence
+     */
+    void begin(const int16_t *history, uint32_t len, uint32_t lag, uint32_t fade_samples);
+
+    /**
+     * @brief Continue the concealed signal
+     *
+     * @param out destination
+     * @param n number of samples
+     */
+    void synthesize(int16_t *out, uint32_t n);
+
+    /**
+     * @brief Crossfade from the continuation of the concealed signal into real audio
+     *
+     * @param real real audio, its first n samples are modified in place
+     * @param n number of samples to crossfade
+     */
+    void crossfadeInto(int16_t *real, uint32_t n);
+
+    /**
+     * @brief Get the estimated pitch period
+     *
+     * @return uint32_t period in samples
+     */
+    uint32_t getLag();
+
+    /**
+     * @brief Estimate the pitch period of the end of a signal (normalized autocorrelation)
+     *
+     * @param history signal, oldest sample first
+     * @param len number of samples
+     * @return uint32_t period in samples
+     */
+    static uint32_t estimateLag(const int16_t *history, uint32_t len);
+
+  private:
+    int16_t period[OPENREMJAM_PLC_MAX_LAG]; // last pitch period of the history
+    uint32_t lag;
+    uint32_t phase;                         // position within period of the next sample
+    int32_t gain;                           // Q30
+    int32_t gain_step;                      // Q30 per sample
+};
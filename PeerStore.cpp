@@ -0,0 +1,248 @@
+#include "PeerStore.h"
+#include <EEPROM.h>
+#include <stddef.h>
+
+PeerStore::PeerStore(QueueController &q)
+    : qc(q), records{}, stored{}, recoveries_failed{}, connections(0), last_save(0), bytes_written(0),
+      header_valid(false), started(false) {
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) queue_record[i] = -1;
+}
+
+void PeerStore::begin() {
+    peer_store_header_t h;
+    EEPROM.get(OPENREMJAM_PEER_STORE_ADDRESS, h);
+    header_valid = h.magic == OPENREMJAM_PEER_STORE_MAGIC && h.version == OPENREMJAM_PEER_STORE_VERSION &&
+                   h.size == OPENREMJAM_PEER_STORE_SIZE && h.record_size == sizeof(peer_record_t);
+    int remembered = 0;
+    for (int r = 0; r < OPENREMJAM_PEER_STORE_SIZE; ++r) {
+        EEPROM.get(OPENREMJAM_PEER_STORE_ADDRESS + sizeof(peer_store_header_t) + r * sizeof(peer_record_t), stored[r]);
+        records[r] = stored[r];
+        if (!header_valid || checksum(records[r]) != records[r].check) {
+            records[r].family = 0; // unused: the first save writes the family and checksum bytes only
+            continue;
+        }
+        if (!records[r].family) continue;
+        remembered++;
+        if (records[r].used > connections) connections = records[r].used;
+    }
+    started = true;
+
+    // the connection table of the last run, for the queues setup() has left unconnected
+    int restored = 0;
+    for (int r = 0; r < OPENREMJAM_PEER_STORE_SIZE; ++r) {
+        int i = records[r].queue;
+        records[r].queue = 0xff; // until a queue connects to the remote host, here or in poll()
+        if (!records[r].family || i >= OPENREMJAM_MAX_PEERS || qc.getQueue(i)->getPort()) continue;
+        struct fnet_sockaddr sa;
+        toSockaddr(records[r], sa);
+        boolean connected = false;
+        for (int k = 0; k < OPENREMJAM_MAX_PEERS; ++k) {
+            if (qc.getQueue(k)->getPort() && matches(records[r], *qc.getQueue(k)->getSockaddrPtr())) connected = true;
+        }
+        if (connected) continue;
+        if (!qc.connect(i, sa)) {
+            Serial.printf("Peer store: queue %d not restored, not enough free slots in the block pool\r\n", i);
+            continue;
+        }
+        attach(i, true);
+        restored++;
+    }
+    Serial.printf("Peer store: %d remote hosts remembered, %d queues restored\r\n", remembered, restored);
+    last_save = millis();
+}
+
+void PeerStore::poll() {
+    if (!started) return;
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+        NetworkJitterBufferPlayQueue *q = qc.getQueue(i);
+        int r = queue_record[i];
+        if (!q->getPort()) {
+            // disconnected: the remote host stays remembered, without a queue
+            if (r >= 0 && records[r].queue == i) records[r].queue = 0xff;
+            queue_record[i] = -1;
+            continue;
+        }
+        if (r >= 0 && matches(records[r], *q->getSockaddrPtr())) continue;
+        if (r >= 0 && records[r].queue == i) records[r].queue = 0xff;
+        attach(i, false);
+    }
+    if (millis() - last_save >= OPENREMJAM_PEER_STORE_INTERVAL_MS) save();
+}
+
+void PeerStore::save() {
+    if (!started) return;
+    last_save = millis();
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+        int r = queue_record[i];
+        if (r < 0) continue;
+        // a good operating point: playing, and no failed recovery since the last save
+        uint32_t failed = qc.getQueue(i)->getRecoveriesFailed();
+        update(i, records[r], qc.getQueue(i)->isPlaying() && failed == recoveries_failed[i]);
+        recoveries_failed[i] = failed;
+    }
+    write();
+}
+
+void PeerStore::clear() {
+    if (!started) return;
+    memset(records, 0, sizeof(records));
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) queue_record[i] = -1;
+    connections = 0;
+    write();
+}
+
+void PeerStore::printInfo() {
+    int used = 0;
+    for (const peer_record_t &r : records) {
+        if (r.family) used++;
+    }
+    Serial.printf("Peer store: %d/%d records used, %lu bytes written to EEPROM since startup\r\n",
+                  used, OPENREMJAM_PEER_STORE_SIZE, bytes_written);
+    for (int k = 0; k < OPENREMJAM_PEER_STORE_SIZE; ++k) {
+        const peer_record_t &r = records[k];
+        if (!r.family) continue;
+        struct fnet_sockaddr sa;
+        toSockaddr(r, sa);
+        Serial.printf("#%2d: %39s:%5u - queue: %2d, gain: %3f, capacity: %2u, max_buffers: %2u, adaptive: %i, drift compensation: %i, send: %s",
+                      k, fnet_inet_ntop(sa.sa_family, &sa.sa_data, print_buffer, sizeof(print_buffer)), r.port,
+                      r.queue == 0xff ? -1 : r.queue, r.gain, r.capacity, r.max_buffers, !!(r.flags & PEER_FLAG_ADAPTIVE),
+                      !!(r.flags & PEER_FLAG_DRIFT), (r.flags & PEER_FLAG_ADPCM) ? "adpcm" : "pcm");
+        if (r.flags & PEER_FLAG_PROFILE) {
+            Serial.printf(", prefill: %2u, jitter: %5u us, drift: %+5d ppm\r\n", r.prefill, r.jitter_us, r.drift_ppm);
+        } else {
+            Serial.println(", no operating point yet");
+        }
+    }
+}
+
+uint8_t PeerStore::checksum(const peer_record_t &r) {
+    // rotate and xor: detects a torn write as well as swapped bytes
+    const uint8_t *b = (const uint8_t *)&r;
+    uint8_t sum = 0x5a;
+    for (uint32_t k = 0; k < offsetof(peer_record_t, check); ++k) sum = (uint8_t)((sum << 1) | (sum >> 7)) ^ b[k];
+    return sum;
+}
+
+void PeerStore::toRecord(const struct fnet_sockaddr &sa, peer_record_t &r) {
+    r.family = sa.sa_family;
+    r.port = fnet_ntohs(sa.sa_port);
+    memset(r.addr, 0, sizeof(r.addr));
+    if (sa.sa_family == AF_INET6) memcpy(r.addr, &((const fnet_sockaddr_in6 *)&sa)->sin6_addr.s6_addr, 16);
+    else memcpy(r.addr, &((const fnet_sockaddr_in *)&sa)->sin_addr.s_addr, 4);
+}
+
+void PeerStore::toSockaddr(const peer_record_t &r, struct fnet_sockaddr &sa) {
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_family = r.family;
+    sa.sa_port = fnet_htons(r.port);
+    if (r.family == AF_INET6) memcpy(&((fnet_sockaddr_in6 *)&sa)->sin6_addr.s6_addr, r.addr, 16);
+    else memcpy(&((fnet_sockaddr_in *)&sa)->sin_addr.s_addr, r.addr, 4);
+}
+
+boolean PeerStore::matches(const peer_record_t &r, const struct fnet_sockaddr &sa) {
+    peer_record_t p;
+    toRecord(sa, p);
+    return r.family == p.family && r.port == p.port && !memcmp(r.addr, p.addr, sizeof(p.addr));
+}
+
+int PeerStore::findRecord(const struct fnet_sockaddr &sa) {
+    for (int r = 0; r < OPENREMJAM_PEER_STORE_SIZE; ++r) {
+        if (records[r].family && matches(records[r], sa)) return r;
+    }
+    return -1;
+}
+
+int PeerStore::allocateRecord() {
+    // an unused record, else the least recently connected remote host that has no queue
+    int lru = -1;
+    for (int r = 0; r < OPENREMJAM_PEER_STORE_SIZE; ++r) {
+        if (!records[r].family) return r;
+        if (records[r].queue == 0xff && (lru < 0 || records[r].used < records[lru].used)) lru = r;
+    }
+    return lru;
+}
+
+void PeerStore::attach(int i, boolean codec) {
+    NetworkJitterBufferPlayQueue *q = qc.getQueue(i);
+    int r = findRecord(*q->getSockaddrPtr());
+    if (r >= 0) {
+        apply(i, records[r], codec);
+    } else {
+        // a new remote host: remember it with the current settings, its operating point follows with the next save
+        r = allocateRecord();
+        if (r < 0) return; // all records belong to connected queues, try again with the next poll()
+        memset(&records[r], 0, sizeof(peer_record_t));
+        toRecord(*q->getSockaddrPtr(), records[r]);
+        update(i, records[r], false);
+    }
+    records[r].queue = i;
+    records[r].used = ++connections;
+    queue_record[i] = r;
+    recoveries_failed[i] = q->getRecoveriesFailed();
+}
+
+void PeerStore::apply(int i, const peer_record_t &r, boolean codec) {
+    NetworkJitterBufferPlayQueue *q = qc.getQueue(i);
+    if (r.capacity != q->getCapacity() && !qc.setCapacity(i, r.capacity)) {
+        Serial.printf("Queue %d: cannot restore capacity %u, not enough free slots in the block pool\r\n", i, r.capacity);
+    }
+    if (r.max_buffers >= 2 && r.max_buffers <= q->getCapacity()) q->setMaxBuffers(r.max_buffers);
+    q->setAdaptive(r.flags & PEER_FLAG_ADAPTIVE);
+    q->setDriftCompensation(r.flags & PEER_FLAG_DRIFT);
+    // an autoconnected remote host has just told us its codec, that one wins
+    if (codec) q->setSendCodec((r.flags & PEER_FLAG_ADPCM) ? Codec::adpcm : Codec::pcm);
+    qc.setGain(i, r.gain);
+    if (r.flags & PEER_FLAG_PROFILE) {
+        q->warmStart(r.prefill, r.jitter_us, r.drift_ppm);
+        Serial.printf("Queue %d: warm start with prefill %u, jitter %u us, drift %+d ppm\r\n", i, r.prefill, r.jitter_us, r.drift_ppm);
+    }
+}
+
+void PeerStore::update(int i, peer_record_t &r, boolean learned) {
+    NetworkJitterBufferPlayQueue *q = qc.getQueue(i);
+    r.gain = qc.getGain(i);
+    r.capacity = q->getCapacity();
+    r.max_buffers = q->getMaxBuffers();
+    r.flags = (r.flags & PEER_FLAG_PROFILE) | (q->getAdaptive() ? PEER_FLAG_ADAPTIVE : 0) |
+              (q->getDriftCompensation() ? PEER_FLAG_DRIFT : 0) | (q->getSendCodec() == Codec::adpcm ? PEER_FLAG_ADPCM : 0);
+    if (!learned) return;
+
+    // rounded, and only taken when they have moved by more than one step: a steady connection writes nothing
+    r.prefill = q->getPrefill();
+    uint32_t jitter = q->getJitter();
+    if (jitter > 65535 - OPENREMJAM_PEER_STORE_JITTER_STEP_US) jitter = 65535 - OPENREMJAM_PEER_STORE_JITTER_STEP_US;
+    int32_t jitter_diff = (int32_t)jitter - r.jitter_us;
+    if (!(r.flags & PEER_FLAG_PROFILE) || jitter_diff > OPENREMJAM_PEER_STORE_JITTER_STEP_US || jitter_diff < -OPENREMJAM_PEER_STORE_JITTER_STEP_US) {
+        r.jitter_us = (jitter + OPENREMJAM_PEER_STORE_JITTER_STEP_US / 2) / OPENREMJAM_PEER_STORE_JITTER_STEP_US * OPENREMJAM_PEER_STORE_JITTER_STEP_US;
+    }
+    float drift = q->getDriftPpm();
+    if (!(r.flags & PEER_FLAG_PROFILE) || drift > r.drift_ppm + 1.5f || drift < r.drift_ppm - 1.5f) {
+        r.drift_ppm = (int16_t)(drift < 0 ? drift - 0.5f : drift + 0.5f);
+    }
+    r.flags |= PEER_FLAG_PROFILE;
+}
+
+void PeerStore::write() {
+    if (!header_valid) {
+        peer_store_header_t h = {OPENREMJAM_PEER_STORE_MAGIC, OPENREMJAM_PEER_STORE_VERSION, OPENREMJAM_PEER_STORE_SIZE, sizeof(peer_record_t)};
+        peer_store_header_t old;
+        EEPROM.get(OPENREMJAM_PEER_STORE_ADDRESS, old);
+        writeBytes(OPENREMJAM_PEER_STORE_ADDRESS, (const uint8_t *)&h, (const uint8_t *)&old, sizeof(h));
+        header_valid = true;
+    }
+    for (int r = 0; r < OPENREMJAM_PEER_STORE_SIZE; ++r) {
+        records[r].check = checksum(records[r]);
+        writeBytes(OPENREMJAM_PEER_STORE_ADDRESS + sizeof(peer_store_header_t) + r * sizeof(peer_record_t),
+                   (const uint8_t *)&records[r], (const uint8_t *)&stored[r], sizeof(peer_record_t));
+        stored[r] = records[r];
+    }
+}
+
+void PeerStore::writeBytes(uint32_t address, const uint8_t *data, const uint8_t *old, uint32_t size) {
+    // diffed against the RAM copy: unchanged bytes cost neither a write nor an EEPROM read
+    for (uint32_t k = 0; k < size; ++k) {
+        if (data[k] == old[k]) continue;
+        EEPROM.write(address + k, data[k]);
+        bytes_written++;
+    }
+}
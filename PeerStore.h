@@ -0,0 +1,132 @@
+#pragma once
+
+#define OPENREMJAM_PEER_STORE_SIZE (32)                   // default: 32 (remote hosts remembered, the least recently connected one is replaced)
+#define OPENREMJAM_PEER_STORE_ADDRESS (0)                 // default: 0 (EEPROM offset of the peer store)
+#define OPENREMJAM_PEER_STORE_INTERVAL_MS (60000)         // default: 60000 (the operating points are saved at most this often, only changed bytes are written)
+#define OPENREMJAM_PEER_STORE_JITTER_STEP_US (100)        // default: 100 (the saved jitter is rounded to this, so noise does not cause writes)
+
+// DO NOT CHANGE THESE:
+#define OPENREMJAM_PEER_STORE_MAGIC (0x5350524f)          // "ORPS"
+#define OPENREMJAM_PEER_STORE_VERSION (1)
+
+#include "fnet.h"
+#include "QueueController.h"
+
+/**
+ * @brief Remembers the remote hosts in EEPROM, so queues start from the last good operating point instead of from
+ *        scratch: the connection table (which queue was connected to which remote host), and per remote host the
+ *        gain, capacity, max_buffers, adaptive and drift settings, the send codec and the learned operating point
+ *        (prefill, jitter estimate, clock drift correction). begin() restores the connection table at startup. Each
+ *        time a queue connects to a remembered remote host, whichever way (CONNECT, autoconnect, control protocol),
+ *        poll() applies its record (see NetworkJitterBufferPlayQueue::warmStart()).
+ *        The operating point of a queue is only taken while it is playing and has had no failed recovery since the
+ *        last save. Writes are wear-aware: a RAM copy of the EEPROM contents is kept, the records are saved at most
+ *        every OPENREMJAM_PEER_STORE_INTERVAL_MS, and only bytes that differ are written. Learned values are rounded
+ *        (jitter to OPENREMJAM_PEER_STORE_JITTER_STEP_US, drift to 1 ppm), so a steady connection writes nothing.
+ *        Runs in loop(), like the serial commands.
+ *
+ */
+class PeerStore {
+  public:
+
+    /**
+     * @brief Construct a new PeerStore object
+     *
+     * @param qc queues to restore and save
+     */
+    PeerStore(QueueController &qc);
+
+    /**
+     * @brief Read the records from EEPROM and connect the queues of the saved connection table that are not
+     *        connected yet (call from setup(), after Ethernet has been initialized and the fixed queues are connected)
+     *
+     */
+    void begin();
+
+    /**
+     * @brief Apply the records of newly connected remote hosts and save the operating points that are due
+     *        (call from loop())
+     *
+     */
+    void poll();
+
+    /**
+     * @brief Save the records of all connected queues now, regardless of OPENREMJAM_PEER_STORE_INTERVAL_MS
+     *
+     */
+    void save();
+
+    /**
+     * @brief Forget all remote hosts (the queues stay connected and are remembered again from the next save)
+     *
+     */
+    void clear();
+
+    /**
+     * @brief Print the records via Serial
+     *
+     */
+    void printInfo();
+
+  private:
+    enum PeerFlags : uint8_t {
+      PEER_FLAG_ADAPTIVE = 1,     // adaptive buffer depth
+      PEER_FLAG_DRIFT = 2,        // clock drift compensation
+      PEER_FLAG_ADPCM = 4,        // send codec IMA-ADPCM
+      PEER_FLAG_PROFILE = 8       // prefill, jitter_us and drift_ppm hold a good operating point
+    };
+
+    typedef struct peer_store_header_struct {
+      uint32_t magic;             // OPENREMJAM_PEER_STORE_MAGIC
+      uint16_t version;           // OPENREMJAM_PEER_STORE_VERSION
+      uint8_t size;               // OPENREMJAM_PEER_STORE_SIZE
+      uint8_t record_size;        // sizeof(peer_record_t)
+    } peer_store_header_t;
+
+    typedef struct peer_record_struct {
+      uint8_t family;             // AF_INET or AF_INET6, 0: unused record
+      uint8_t queue;              // queue the remote host is connected to, 0xff: none
+      uint16_t port;              // host byte order
+      uint8_t addr[16];           // IPv4: the first 4 bytes, network byte order
+      uint32_t used;              // connection counter of the last connect (least recently used records are replaced)
+      float gain;
+      uint16_t jitter_us;         // multiple of OPENREMJAM_PEER_STORE_JITTER_STEP_US
+      int16_t drift_ppm;
+      uint8_t capacity;
+      uint8_t max_buffers;
+      uint8_t prefill;
+      uint8_t flags;              // PeerFlags
+      uint8_t reserved;
+      uint8_t check;              // checksum of the bytes above, a record torn by a reset is ignored
+    } peer_record_t;
+
+    static_assert(sizeof(peer_record_t) == 40, "peer_record_t is stored as is");
+#if defined(E2END)
+    static_assert(OPENREMJAM_PEER_STORE_ADDRESS + sizeof(peer_store_header_t) + OPENREMJAM_PEER_STORE_SIZE * sizeof(peer_record_t) <= E2END + 1,
+                  "the peer store does not fit into EEPROM");
+#endif
+
+    QueueController &qc;
+    peer_record_t records[OPENREMJAM_PEER_STORE_SIZE];
+    peer_record_t stored[OPENREMJAM_PEER_STORE_SIZE];  // what the EEPROM holds, writes are diffed against it
+    int8_t queue_record[OPENREMJAM_MAX_PEERS];         // record index of each connected queue, -1: none
+    uint32_t recoveries_failed[OPENREMJAM_MAX_PEERS];  // at the last save, see save()
+    uint32_t connections;                              // highest used of all records
+    uint32_t last_save;                                // millis()
+    uint32_t bytes_written;                            // since startup
+    boolean header_valid;
+    boolean started;
+    fnet_char_t print_buffer[FNET_IP6_ADDR_STR_SIZE];
+
+    static uint8_t checksum(const peer_record_t &r);
+    static void toRecord(const struct fnet_sockaddr &sa, peer_record_t &r);
+    static void toSockaddr(const peer_record_t &r, struct fnet_sockaddr &sa);
+    static boolean matches(const peer_record_t &r, const struct fnet_sockaddr &sa);
+    int findRecord(const struct fnet_sockaddr &sa);
+    int allocateRecord();
+    void attach(int i, boolean codec);
+    void apply(int i, const peer_record_t &r, boolean codec);
+    void update(int i, peer_record_t &r, boolean learned);
+    void write();
+    void writeBytes(uint32_t address, const uint8_t *data, const uint8_t *old, uint32_t size);
+};
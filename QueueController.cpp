@@ -1,71 +1,70 @@
 #include "QueueController.h"
 
-QueueController::QueueController()
-    : queue{NetworkJitterBufferPlayQueue(), NetworkJitterBufferPlayQueue(),
-            NetworkJitterBufferPlayQueue(), NetworkJitterBufferPlayQueue(),
-            NetworkJitterBufferPlayQueue(), NetworkJitterBufferPlayQueue(),
-            NetworkJitterBufferPlayQueue(), NetworkJitterBufferPlayQueue(),
-            NetworkJitterBufferPlayQueue(), NetworkJitterBufferPlayQueue(),
-            NetworkJitterBufferPlayQueue(), NetworkJitterBufferPlayQueue(),
-            NetworkJitterBufferPlayQueue(), NetworkJitterBufferPlayQueue(),
-            NetworkJitterBufferPlayQueue(), NetworkJitterBufferPlayQueue()},
-      mixer{AudioMixer4(), AudioMixer4(), AudioMixer4(), AudioMixer4(),
-            AudioMixer4()},
-      i2s_out{AudioOutputI2S()},
-      con{
-          AudioConnection(queue[0], 0, mixer[0], 0),
-          AudioConnection(queue[1], 0, mixer[0], 1),
-          AudioConnection(queue[2], 0, mixer[0], 2),
-          AudioConnection(queue[3], 0, mixer[0], 3),
-          AudioConnection(queue[4], 0, mixer[1], 0),
-          AudioConnection(queue[5], 0, mixer[1], 1),
-          AudioConnection(queue[6], 0, mixer[1], 2),
-          AudioConnection(queue[7], 0, mixer[1], 3),
-          AudioConnection(queue[8], 0, mixer[2], 0),
-          AudioConnection(queue[9], 0, mixer[2], 1),
-          AudioConnection(queue[10], 0, mixer[2], 2),
-          AudioConnection(queue[11], 0, mixer[2], 3),
-          AudioConnection(queue[12], 0, mixer[3], 0),
-          AudioConnection(queue[13], 0, mixer[3], 1),
-          AudioConnection(queue[14], 0, mixer[3], 2),
-          AudioConnection(queue[15], 0, mixer[3], 3),
-          AudioConnection(mixer[0], 0, mixer[4], 0),
-          AudioConnection(mixer[1], 0, mixer[4], 1),
-          AudioConnection(mixer[2], 0, mixer[4], 2),
-          AudioConnection(mixer[3], 0, mixer[4], 3),
-          AudioConnection(mixer[4], 0, i2s_out, 0),
-          AudioConnection(mixer[4], 0, i2s_out, 1),
-      },
-      gain{1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0,
-           1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0},
-      autoconnect{true}, autodisconnect{true} {}
+QueueController::QueueController(NetworkJitterBufferPlayQueue * (&queues)[OPENREMJAM_MAX_PEERS]) {
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) queue[i] = queues[i];
+    begin();
+}
 
+void QueueController::begin() {
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) gain[i] = 1.0;
+    autoconnect = true;
+    autodisconnect = true;
 
+    mixminus.begin(queue);
+    int c = 0;
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+        con[c++].connect(*queue[i], 0, mixer, i);
+        con[c++].connect(*queue[i], 0, mixminus, i);
+    }
+    con[c++].connect(mixer, 0, i2s_out, 0);
+    con[c++].connect(mixer, 0, i2s_out, 1);
 
+    rebuildPeerTable();
+}
 
-int QueueController::getQueueIndexByIP(IPAddress ip, uint16_t port) {
-    for (int i = 0; i < 16; ++i) {
-        if (!queue[i].hasIP6() && queue[i].getIPv4() == ip &&
-            queue[i].getPort() == port)
-            return i;
+uint32_t QueueController::hashPeer(uint32_t a, uint16_t port) {
+    // multiplicative (Fibonacci) hashing, the top bits are well mixed
+    return ((a ^ (port * 0x9E3779B1u)) * 0x9E3779B1u) >> (32 - OPENREMJAM_PEER_TABLE_BITS);
+}
+
+uint32_t QueueController::foldIPv6(const fnet_ip6_addr_t &ip6) {
+    return ip6.addr32[0] ^ ip6.addr32[1] ^ ip6.addr32[2] ^ ip6.addr32[3];
+}
+
+uint32_t QueueController::hashQueue(int i) {
+    if (queue[i]->hasIP6()) return hashPeer(foldIPv6(*queue[i]->getIP6Ptr()), queue[i]->getPort());
+    return hashPeer(queue[i]->getIPv4(), queue[i]->getPort());
+}
+
+void QueueController::rebuildPeerTable() {
+    // called on (dis)connect only, so there is no need to support deletion
+    memset(peer_table, -1, sizeof(peer_table));
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+        if (!queue[i]->getPort()) continue;
+        uint32_t h = hashQueue(i);
+        while (peer_table[h] >= 0) h = (h + 1) & (OPENREMJAM_PEER_TABLE_SIZE - 1);
+        peer_table[h] = i;
     }
-    return -1;
+}
+
+int QueueController::getQueueIndexByIP(IPAddress ip, uint16_t port) {
+    return getQueueIndexByIPv4(ip, port);
 }
 
 int QueueController::getQueueIndexByIPv4(fnet_ip4_addr_t ip, uint16_t port) {
-    for (int i = 0; i < 16; ++i) {
-        if (!queue[i].hasIP6() && queue[i].getIPv4() == ip &&
-            queue[i].getPort() == port)
-            return i;
+    for (uint32_t h = hashPeer(ip, port); peer_table[h] >= 0; h = (h + 1) & (OPENREMJAM_PEER_TABLE_SIZE - 1)) {
+        NetworkJitterBufferPlayQueue *q = queue[peer_table[h]];
+        if (!q->hasIP6() && q->getIPv4() == ip && q->getPort() == port)
+            return peer_table[h];
     }
     return -1;
 }
 
 int QueueController::getQueueIndexByIPv6(fnet_ip6_addr_t &ip6, uint16_t port) {
-    for (int i = 0; i < 16; ++i) {
-        if ((queue[i].hasIP6()) && (queue[i].getPort() == port) &&
-            (FNET_IP6_ADDR_EQUAL(queue[i].getIP6Ptr(), &ip6)))
-            return i;
+    for (uint32_t h = hashPeer(foldIPv6(ip6), port); peer_table[h] >= 0; h = (h + 1) & (OPENREMJAM_PEER_TABLE_SIZE - 1)) {
+        NetworkJitterBufferPlayQueue *q = queue[peer_table[h]];
+        if (q->hasIP6() && q->getPort() == port && FNET_IP6_ADDR_EQUAL(q->getIP6Ptr(), &ip6))
+            return peer_table[h];
     }
     return -1;
 }
@@ -77,16 +76,16 @@ int QueueController::getFreeAutoconnectQueueIndex() {
 
 int QueueController::getFreeQueueIndex() {
     // i == 0 is reserved for localhost/loopback 
-    for (int i = 1; i < 16; ++i) {
-        if (queue[i].getPort() == 0)
+    for (int i = 1; i < OPENREMJAM_MAX_PEERS; ++i) {
+        if (queue[i]->getPort() == 0)
             return i;
     }
     return -1;
 }
 
 NetworkJitterBufferPlayQueue *QueueController::getQueue(int j) {
-    if (j >= 0 && j < 16)
-        return &queue[j];
+    if (j >= 0 && j < OPENREMJAM_MAX_PEERS)
+        return queue[j];
     Serial.println("Warning: getQueue returning nullptr!");
     return nullptr;
 }
@@ -95,7 +94,8 @@ float QueueController::getGain(int i) { return gain[i]; }
 
 void QueueController::setGain(int i, float f) {
     gain[i] = f;
-    mixer[i / 4].gain(i % 4, f);
+    mixer.gain(i, f);
+    mixminus.gain(i, f);
 }
 
 void QueueController::setAutoconnect(boolean val) {
@@ -112,25 +112,90 @@ boolean QueueController::getAutodisconnect() {
     return autodisconnect;
 }
 
+boolean QueueController::getServerMode() { return mixminus.getEnabled(); }
+
+void QueueController::setServerMode(boolean val) {
+    mixminus.setEnabled(val);
+}
+
+MixMinusServer<OPENREMJAM_MAX_PEERS> *QueueController::getMixMinus() { return &mixminus; }
+
+boolean QueueController::setCapacity(int i, uint32_t n) {
+    NetworkJitterBufferPlayQueue *q = getQueue(i);
+    uint16_t port = q->getPort();
+    // check before the restart: a failed call leaves the queue as it was
+    if (!q->isValidCapacity(n) || (port && !q->canAcquireSlots(n))) return false;
+    if (port) q->setPort(0);
+    q->setCapacity(n);
+    if (port && !q->setPort(port)) {
+        rebuildPeerTable(); // cannot happen, the slots have been checked above: disconnected
+        return false;
+    }
+    return true;
+}
+
 void QueueController::disconnect(int id) {
     setAutoconnect(false);
     getQueue(id)->setPort(0);
     getQueue(id)->setIP(IPAddress(0,0,0,0));
+    getQueue(id)->setSendCodec(Codec::pcm);
+    rebuildPeerTable();
 }
 
-void QueueController::connect(int id, IPAddress ip, int port) {
+boolean QueueController::connect(int id, IPAddress ip, int port) {
     getQueue(id)->setIP(ip);
-    getQueue(id)->setPort(port);
+    if (!getQueue(id)->setPort(port)) return false; // unconnected as before, the peer table stays
+    rebuildPeerTable();
+    return true;
+}
+
+boolean QueueController::connect(int id, struct fnet_sockaddr &sa) {
+    if (!getQueue(id)->setSockaddr(sa)) return false;
+    rebuildPeerTable();
+    return true;
 }
 
 void QueueController::printInfo(int i) {
-    if (i >= 0 && i < 16) {
-        Serial.printf("#%2i: %39s:%5i - gain: %3f, max_buffers: %2i, prefill: %2i\r\n",
+    if (i >= 0 && i < OPENREMJAM_MAX_PEERS) {
+        Serial.printf("#%2i: %39s:%5i - gain: %3f, max_buffers: %2i/%2lu, prefill: %2i, adaptive: %i, jitter: %5lu us, drift: %+7.1f ppm, latency: %6lu us, send: %s\r\n",
               i,
               fnet_inet_ntop(getQueue(i)->getSockaddrPtr()->sa_family, &getQueue(i)->getSockaddrPtr()->sa_data, ipv6_print_buffer, sizeof(ipv6_print_buffer)),
               getQueue(i)->getPort(),
               getGain(i),
               getQueue(i)->getMaxBuffers(),
-              getQueue(i)->getPrefill());
+              getQueue(i)->getCapacity(),
+              getQueue(i)->getPrefill(),
+              getQueue(i)->getAdaptive(),
+              getQueue(i)->getJitter(),
+              getQueue(i)->getDriftPpm(),
+              getQueue(i)->getLatency().getAvg(),
+              getQueue(i)->getSendCodec() == Codec::adpcm ? "adpcm" : "pcm");
     }
 }
+
+void QueueController::printCpuUsage() {
+    Serial.printf("Mixer (%%):               %.2f (peak %.2f)\r\n", mixer.processorUsage(), mixer.processorUsageMax());
+    Serial.printf("Mix-minus (%%):           %.2f (peak %.2f)\r\n", mixminus.processorUsage(), mixminus.processorUsageMax());
+    Serial.printf("I2S output (%%):          %.2f (peak %.2f)\r\n", i2s_out.processorUsage(), i2s_out.processorUsageMax());
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+        NetworkJitterBufferPlayQueue *q = getQueue(i);
+        if (!q->getPort()) continue;
+        Serial.printf("#%2i update/enqueue (%%):  %.2f (peak %.2f) / %.2f (peak %.2f, longest %.1f us)\r\n", i,
+                      q->processorUsage(), q->processorUsageMax(),
+                      q->getEnqueueCpu().getUsage(), q->getEnqueueCpu().getUsageMax(), q->getEnqueueCpu().getCallMaxUs());
+    }
+}
+
+void QueueController::resetCpuUsageMax() {
+    mixer.processorUsageMaxReset();
+    mixminus.processorUsageMaxReset();
+    i2s_out.processorUsageMaxReset();
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+        getQueue(i)->processorUsageMaxReset();
+        getQueue(i)->getEnqueueCpu().resetMax();
+    }
+}
+
+void QueueController::printStatisticsIfDue() {
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) getQueue(i)->printStatisticsIfDue();
+}
@@ -1,8 +1,19 @@
 #pragma once
 
+#define OPENREMJAM_MAX_PEERS (16)                         // default: 16 (number of queues, i.e. remote hosts including loopback, max. 127)
+#define OPENREMJAM_LOOP_STALL_MAX_US (20000)              // default: 20000 (longest loop() iteration the audio input is buffered for, compare with "longest loop()" of the CPU command)
+
+// DO NOT CHANGE THESE:
+#define OPENREMJAM_PEER_TABLE_BITS (OPENREMJAM_MAX_PEERS <= 16 ? 5 : OPENREMJAM_MAX_PEERS <= 32 ? 6 : OPENREMJAM_MAX_PEERS <= 64 ? 7 : 8) // at most half full
+#define OPENREMJAM_PEER_TABLE_SIZE (1 << OPENREMJAM_PEER_TABLE_BITS)
+#define OPENREMJAM_INPUT_BACKLOG_BLOCKS ((OPENREMJAM_LOOP_STALL_MAX_US * 441 / 10000 + AUDIO_BLOCK_SAMPLES - 1) / AUDIO_BLOCK_SAMPLES + 1) // input blocks rec_queue holds while loop() stalls
+#define OPENREMJAM_AUDIO_MEMORY (OPENREMJAM_MAX_PEERS + OPENREMJAM_INPUT_BACKLOG_BLOCKS + 10) // the queues keep their audio in network block slots (see NetworkBlockPool), each has one audio block in flight per audio cycle. Plus the input backlog, and 10 blocks headroom (input, mixer, output)
+
 #include "Audio.h"
 #include "NativeEthernet.h"
 #include "NetworkJitterBufferPlayQueue.h"
+#include "AudioMixerMulti.h"
+#include "MixMinusServer.h"
 
 /**
  * @brief Manages all input queues as well as our audio output via i2s
@@ -10,27 +21,49 @@
  */
 class QueueController {
   private:
-    NetworkJitterBufferPlayQueue queue[16];
-    AudioMixer4 mixer[5]; // we need 5 mixers and 22 connections to connect 16 queues
+    static_assert(OPENREMJAM_MAX_PEERS >= 1 && OPENREMJAM_MAX_PEERS <= 127, "peer_table holds int8_t queue indices");
+
+    NetworkJitterBufferPlayQueue *queue[OPENREMJAM_MAX_PEERS];
+    AudioMixerMulti<OPENREMJAM_MAX_PEERS> mixer; // mixes all queues in one pass
+    MixMinusServer<OPENREMJAM_MAX_PEERS> mixminus; // server mode: one mix per client, without the client
     AudioOutputI2S i2s_out;
-    AudioConnection con[22];
-    float gain[16]; // gain setting for each input;
+    AudioConnection con[2 * OPENREMJAM_MAX_PEERS + 2]; // queues to mixer and mixminus, mixer to i2s left/right
+    float gain[OPENREMJAM_MAX_PEERS]; // gain setting for each input;
     boolean autoconnect;
     boolean autodisconnect;
+    int8_t peer_table[OPENREMJAM_PEER_TABLE_SIZE]; // open addressing (linear probing): queue index by remote address and port, -1: empty
     fnet_char_t ipv6_print_buffer[FNET_IP6_ADDR_STR_SIZE];
+
+    static uint32_t hashPeer(uint32_t a, uint16_t port);
+    static uint32_t foldIPv6(const fnet_ip6_addr_t &ip6);
+    uint32_t hashQueue(int i);
+    void rebuildPeerTable();
+    void begin();
   public:
     /**
      * @brief Construct a new QueueController object
      * 
+     * @param queues the play queues (can be NetworkJitterBufferRing of different shapes)
      */
-    QueueController();
+    QueueController(NetworkJitterBufferPlayQueue * (&queues)[OPENREMJAM_MAX_PEERS]);
+
+    /**
+     * @brief Construct a new QueueController object with queues of the same type
+     * 
+     * @param queues the play queues (e.g. DefaultNetworkJitterBufferPlayQueue)
+     */
+    template <class Q>
+    QueueController(Q (&queues)[OPENREMJAM_MAX_PEERS]) {
+      for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) queue[i] = &queues[i];
+      begin();
+    }
 
     /**
      * @brief Get the queue index by Arduino-style IP address
      * 
      * @param ip IP address
      * @param port port number 
-     * @return int queue index [0..15]
+     * @return int queue index [0..OPENREMJAM_MAX_PEERS-1]
      */
     int getQueueIndexByIP(IPAddress ip, uint16_t port);
 
@@ -39,7 +72,7 @@ class QueueController {
      * 
      * @param ip IP address
      * @param port port number
-     * @return int queue index [0..15]
+     * @return int queue index [0..OPENREMJAM_MAX_PEERS-1]
      */
     int getQueueIndexByIPv4(fnet_ip4_addr_t ip, uint16_t port);
 
@@ -48,36 +81,47 @@ class QueueController {
      * 
      * @param ip6 
      * @param port 
-     * @return int [0..15]
+     * @return int [0..OPENREMJAM_MAX_PEERS-1]
      */
     int getQueueIndexByIPv6(fnet_ip6_addr_t &ip6, uint16_t port);
 
     /**
      * @brief Get the index of an unused autoconnect queue 
      * 
-     * @return int index [0..15]
+     * @return int index [0..OPENREMJAM_MAX_PEERS-1]
      */
     int getFreeAutoconnectQueueIndex();
 
     /**
      * @brief Get the index of and unused queue
      * 
-     * @return int index [0..15]
+     * @return int index [0..OPENREMJAM_MAX_PEERS-1]
      */
     int getFreeQueueIndex();
 
     /**
      * @brief Get a pointer to a queue instance
      * 
-     * @param i queue index [0..15]
+     * @param i queue index [0..OPENREMJAM_MAX_PEERS-1]
      * @return NetworkJitterBufferPlayQueue* queue pointer
      */
     NetworkJitterBufferPlayQueue *getQueue(int i);
 
+    /**
+     * @brief Set the capacity of a queue (see NetworkJitterBufferPlayQueue::setCapacity()). A connected queue is
+     *        restarted: it stops, which returns its slots to the block pool, and syncs again with the new capacity.
+     * 
+     * @param i index of queue [0..OPENREMJAM_MAX_PEERS-1]
+     * @param n power of two, 2...getMaxCapacity() of the queue
+     * @return boolean false if n is invalid or the block pool has too few free slots for a connected queue, which
+     *         then keeps its capacity and stays connected
+     */
+    boolean setCapacity(int i, uint32_t n);
+
     /**
      * @brief Set the gain of a queue
      * 
-     * @param i index of queue [0..15]
+     * @param i index of queue [0..OPENREMJAM_MAX_PEERS-1]
      * @param f gain -32767.0...32767.0 
      */
     void setGain(int i, float f);
@@ -85,7 +129,7 @@ class QueueController {
     /**
      * @brief Get the current gain
      * 
-     * @param i index of queue [0..15]
+     * @param i index of queue [0..OPENREMJAM_MAX_PEERS-1]
      * @return float gain -32767.0...32767.0 
      */
     float getGain(int i);
@@ -131,13 +175,66 @@ class QueueController {
      * @param id queue-id
      * @param ip remote IP address
      * @param port remote port 
+     * @return boolean false if the queue gets no slots from the block pool: it stays unconnected, and incoming
+     *         packets are not looked up for it
+     */
+    boolean connect(int id, IPAddress ip, int port);
+
+    /**
+     * @brief Connect a queue to an IPv4 or IPv6 remote host
+     * 
+     * @param id queue-id
+     * @param sa remote sockaddr (address and port)
+     * @return boolean false if the queue gets no slots from the block pool, see connect(int, IPAddress, int)
+     */
+    boolean connect(int id, struct fnet_sockaddr &sa);
+
+    /**
+     * @brief Is server (mix-minus relay) mode enabled?
+     * 
+     * @return boolean 
      */
-    void connect(int id, IPAddress ip, int port);
+    boolean getServerMode();
+
+    /**
+     * @brief Set server mode on (true) or off (false). In server mode, each connected remote host (client) receives
+     *        the mix of all other queues instead of our local signal, see MixMinusServer. Our local signal reaches the
+     *        clients through the loopback queue.
+     * 
+     * @param val 
+     */
+    void setServerMode(boolean val);
+
+    /**
+     * @brief Get the mix-minus streams of server mode (see FanoutSender::sendMixMinus())
+     * 
+     * @return MixMinusServer<OPENREMJAM_MAX_PEERS>* 
+     */
+    MixMinusServer<OPENREMJAM_MAX_PEERS> *getMixMinus();
 
     /**
      * @brief Print status information of a queue
      * 
-     * @param i index of queue [0..15]
+     * @param i index of queue [0..OPENREMJAM_MAX_PEERS-1]
      */
     void printInfo(int i);
+
+    /**
+     * @brief Print the CPU usage of the output path, current and peak: mixer, mix-minus, I2S output and each
+     *        connected queue (update() in the audio interrupt, receive path in loop(), see getEnqueueCpu())
+     * 
+     */
+    void printCpuUsage();
+
+    /**
+     * @brief Start over with the peak CPU usage of the output path and the queues
+     * 
+     */
+    void resetCpuUsageMax();
+
+    /**
+     * @brief Print the periodic statistics of the queues that are due (call from loop())
+     * 
+     */
+    void printStatisticsIfDue();
 };
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Audio.h"
+
+/**
+ * @brief Running minimum, average and maximum of a measured value (e.g. a delay in microseconds)
+ *
+ */
+class RunningStat {
+  public:
+
+    /**
+     * @brief Construct a new, empty RunningStat object
+     *
+     */
+    RunningStat(void) { reset(); }
+
+    /**
+     * @brief Forget all values
+     *
+     */
+    void reset() {
+      min = UINT32_MAX;
+      max = 0;
+      sum = 0;
+      count = 0;
+    }
+
+    /**
+     * @brief Add a value
+     *
+     * @param v value
+     */
+    void add(uint32_t v) {
+      if (v < min) min = v;
+      if (v > max) max = v;
+      sum += v;
+      count++;
+    }
+
+    /**
+     * @brief Get the number of values
+     *
+     * @return uint32_t count
+     */
+    uint32_t getCount() const { return count; }
+
+    /**
+     * @brief Get the minimum
+     *
+     * @return uint32_t minimum, 0 if there are no values
+     */
+    uint32_t getMin() const { return count ? min : 0; }
+
+    /**
+     * @brief Get the average
+     *
+     * @return uint32_t average, 0 if there are no values
+     */
+    uint32_t getAvg() const { return count ? sum / count : 0; }
+
+    /**
+     * @brief Get the maximum
+     *
+     * @return uint32_t maximum, 0 if there are no values
+     */
+    uint32_t getMax() const { return max; }
+
+  private:
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t count;
+};
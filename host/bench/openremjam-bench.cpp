@@ -0,0 +1,28 @@
+// openremjam-bench: the microbenchmarks of Benchmark.cpp on the host. See README.md, section "Benchmarks".
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Benchmark.h"
+
+int main(int argc, char **argv) {
+    bool header = true;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--no-header")) {
+            header = false;
+        } else {
+            printf("Usage: openremjam-bench [--no-header]\r\n"
+                   "Prints one CSV line per benchmark, see Benchmark.h\r\n");
+            return strcmp(argv[i], "--help") ? 2 : 0;
+        }
+    }
+
+    // queues are constructed before the QueueController's mixers (the audio graph updates in construction order)
+    static DefaultNetworkJitterBufferPlayQueue queues[OPENREMJAM_MAX_PEERS];
+    static QueueController qc(queues);
+    AudioMemory(OPENREMJAM_AUDIO_MEMORY);
+    HostClock::set(1000000);
+
+    Benchmark::run(qc, header);
+    return 0;
+}
@@ -0,0 +1,222 @@
+// openremjam-ctl: watch and tune OpenRemjam devices over the telemetry and control port. See README.md, section
+// "Remote monitoring and control".
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "ControlProtocol.h"
+
+static uint16_t control_port = OPENREMJAM_CONTROL_UDP_PORT;
+
+static void usage() {
+    printf("Usage: openremjam-ctl [--port P] <command>\r\n"
+           "Commands:\r\n"
+           "  watch [--interval MS] [--count N] HOST...   print telemetry of one or more devices (default: every 1000 ms,\r\n"
+           "                                             at least every %d ms)\r\n"
+           "  set HOST QUEUE PARAM VALUE                 PARAM: max-buffers, prefill, gain (e.g. 0.5), adaptive (0|1),\r\n"
+           "                                             drift (0|1), codec (pcm|adpcm), capacity (power of two)\r\n"
+           "  connect HOST QUEUE IP PORT                 connect a queue of the device to a remote host\r\n"
+           "  disconnect HOST QUEUE                      disconnect a queue (also disables autoconnect)\r\n"
+           "Options:\r\n"
+           "  --port P            control port of the devices (default %d)\r\n",
+           OPENREMJAM_CONTROL_MIN_INTERVAL_MS, OPENREMJAM_CONTROL_UDP_PORT);
+}
+
+static uint64_t nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool parseHost(const char *s, struct sockaddr_in &sa) {
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(control_port);
+    return inet_pton(AF_INET, s, &sa.sin_addr) == 1;
+}
+
+static void fillHeader(control_header_t &h, ControlType type, uint32_t seqno) {
+    h.magic = OPENREMJAM_CONTROL_MAGIC;
+    h.version = OPENREMJAM_CONTROL_VERSION;
+    h.type = type;
+    h.seqno = seqno;
+}
+
+static const char *statusName(ControlStatus s) {
+    switch (s) {
+        case ControlStatus::ok: return "ok";
+        case ControlStatus::invalid_queue: return "invalid queue";
+        case ControlStatus::invalid_value: return "invalid value";
+        case ControlStatus::unsupported: return "unsupported";
+        case ControlStatus::full: return "too many subscribers";
+        case ControlStatus::no_slots: return "not enough free slots in the block pool";
+    }
+    return "unknown";
+}
+
+// send a request and wait for its ack, with retries. Returns 0 on success, 1 if the device refused, 3 on timeout
+static int request(int sock, const struct sockaddr_in &device, void *msg, size_t size) {
+    control_header_t &h = *(control_header_t *)msg;
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        sendto(sock, msg, size, 0, (const struct sockaddr *)&device, sizeof(device));
+        uint64_t deadline = nowMs() + 500;
+        for (uint64_t now = nowMs(); now < deadline; now = nowMs()) {
+            struct pollfd p = {sock, POLLIN, 0};
+            if (poll(&p, 1, deadline - now) <= 0) break;
+            control_ack_t ack;
+            ssize_t n = recv(sock, &ack, sizeof(ack), 0);
+            if (n < (ssize_t)sizeof(ack) || ack.h.magic != OPENREMJAM_CONTROL_MAGIC || ack.h.type != ControlType::ack ||
+                ack.h.seqno != h.seqno) continue;
+            if (ack.status != ControlStatus::ok) {
+                fprintf(stderr, "Error: %s\r\n", statusName(ack.status));
+                return 1;
+            }
+            return 0;
+        }
+    }
+    fprintf(stderr, "Error: no answer from the device\r\n");
+    return 3;
+}
+
+static void printQueue(const char *host, const control_queue_t &q) {
+    char ip[INET_ADDRSTRLEN] = "IPv6";
+    if (q.ip) inet_ntop(AF_INET, &q.ip, ip, sizeof(ip));
+    printf("%-15s %3u %15s:%-5u %2u %2u/%2u/%2u %c%c %-5s %7.3f %+8.1f %6u %6u %6u %6u %6u %7u %7u %7u %7u\r\n",
+           host, q.queue, ip, q.port, q.queue_length, q.prefill, q.max_buffers, q.capacity,
+           (q.flags & OPENREMJAM_CONTROL_FLAG_ADAPTIVE) ? 'A' : '-', (q.flags & OPENREMJAM_CONTROL_FLAG_DRIFT) ? 'D' : '-',
+           (q.flags & OPENREMJAM_CONTROL_FLAG_ADPCM) ? "adpcm" : "pcm", q.gain / 1000.0, q.drift / 1000.0,
+           q.jitter, q.jitter_p99, q.rtt, q.buffering_delay, q.latency,
+           q.late_packets, q.recoveries_success + q.recoveries_failed, q.concealed_packets, q.fec_recovered_packets);
+}
+
+static int watch(int sock, const std::vector<struct sockaddr_in> &devices, uint32_t interval_ms, long count) {
+    control_subscribe_t sub;
+    uint32_t seqno = 0;
+    uint64_t renew = 0;
+    uint32_t buf[OPENREMJAM_CONTROL_MAX_PACKET_SIZE / 4];
+    printf("%-15s %3s %21s %2s %8s %2s %-5s %7s %8s %6s %6s %6s %6s %6s %7s %7s %7s %7s\r\n",
+           "device", "q", "remote host", "ln", "pre/max", "", "codec", "gain", "drift", "jitter", "p99", "rtt", "buffer",
+           "total", "late", "recov", "conceal", "fec");
+    while (count != 0) {
+        if (nowMs() >= renew) {
+            // subscriptions expire after OPENREMJAM_CONTROL_LEASE_MS
+            for (const struct sockaddr_in &d : devices) {
+                fillHeader(sub.h, ControlType::subscribe, seqno++);
+                sub.interval_ms = interval_ms;
+                sendto(sock, &sub, sizeof(sub), 0, (const struct sockaddr *)&d, sizeof(d));
+            }
+            renew = nowMs() + OPENREMJAM_CONTROL_LEASE_MS / 3;
+        }
+        struct pollfd p = {sock, POLLIN, 0};
+        if (poll(&p, 1, 100) <= 0) continue;
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+        const control_telemetry_t &t = *(const control_telemetry_t *)buf;
+        if (n < (ssize_t)sizeof(t) || t.h.magic != OPENREMJAM_CONTROL_MAGIC || t.h.type != ControlType::telemetry ||
+            n < (ssize_t)(sizeof(t) + t.queues * sizeof(control_queue_t))) continue;
+        char host[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &from.sin_addr, host, sizeof(host));
+        const control_queue_t *queues = (const control_queue_t *)&(&t)[1];
+        for (int i = 0; i < t.queues; ++i) printQueue(host, queues[i]);
+        if (!t.more && count > 0) count--;
+    }
+    // end the subscriptions
+    for (const struct sockaddr_in &d : devices) {
+        fillHeader(sub.h, ControlType::subscribe, seqno++);
+        sub.interval_ms = 0;
+        sendto(sock, &sub, sizeof(sub), 0, (const struct sockaddr *)&d, sizeof(d));
+    }
+    return 0;
+}
+
+static bool parseParam(const char *name, const char *value, control_set_t &m) {
+    char *end;
+    if (!strcasecmp(name, "gain")) {
+        double g = strtod(value, &end);
+        m.param = ControlParam::gain;
+        m.value = (int32_t)(g * 1000.0 + 0.5);
+        return *end == 0 && g >= 0;
+    }
+    if (!strcasecmp(name, "codec")) {
+        m.param = ControlParam::codec;
+        m.value = !strcasecmp(value, "adpcm");
+        return m.value || !strcasecmp(value, "pcm");
+    }
+    if (!strcasecmp(name, "max-buffers")) m.param = ControlParam::max_buffers;
+    else if (!strcasecmp(name, "prefill")) m.param = ControlParam::prefill;
+    else if (!strcasecmp(name, "adaptive")) m.param = ControlParam::adaptive;
+    else if (!strcasecmp(name, "drift")) m.param = ControlParam::drift;
+    else if (!strcasecmp(name, "capacity")) m.param = ControlParam::capacity;
+    else return false;
+    m.value = strtol(value, &end, 10);
+    return *end == 0;
+}
+
+int main(int argc, char **argv) {
+    int i = 1;
+    if (i + 1 < argc && !strcmp(argv[i], "--port")) {
+        control_port = atoi(argv[i + 1]);
+        i += 2;
+    }
+    if (i >= argc) {
+        usage();
+        return 2;
+    }
+    const char *cmd = argv[i++];
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return 1;
+    }
+    uint32_t seqno = (uint32_t)time(nullptr);
+    struct sockaddr_in device;
+
+    if (!strcmp(cmd, "watch")) {
+        uint32_t interval_ms = 1000;
+        long count = -1;
+        std::vector<struct sockaddr_in> devices;
+        for (; i < argc; ++i) {
+            if (!strcmp(argv[i], "--interval") && i + 1 < argc) interval_ms = atoi(argv[++i]);
+            else if (!strcmp(argv[i], "--count") && i + 1 < argc) count = atol(argv[++i]);
+            else if (parseHost(argv[i], device)) devices.push_back(device);
+            else {
+                usage();
+                return 2;
+            }
+        }
+        if (devices.empty() || interval_ms < OPENREMJAM_CONTROL_MIN_INTERVAL_MS) {
+            usage();
+            return 2;
+        }
+        return watch(sock, devices, interval_ms, count);
+    }
+    if (!strcmp(cmd, "set") && argc - i == 4 && parseHost(argv[i], device)) {
+        control_set_t m = {};
+        fillHeader(m.h, ControlType::set, seqno);
+        m.queue = atoi(argv[i + 1]);
+        if (parseParam(argv[i + 2], argv[i + 3], m)) return request(sock, device, &m, sizeof(m));
+    } else if (!strcmp(cmd, "connect") && argc - i == 4 && parseHost(argv[i], device)) {
+        control_connect_t m = {};
+        fillHeader(m.h, ControlType::connect, seqno);
+        m.queue = atoi(argv[i + 1]);
+        m.port = atoi(argv[i + 3]);
+        if (inet_pton(AF_INET, argv[i + 2], &m.ip) == 1) return request(sock, device, &m, sizeof(m));
+    } else if (!strcmp(cmd, "disconnect") && argc - i == 2 && parseHost(argv[i], device)) {
+        control_set_t m = {};
+        fillHeader(m.h, ControlType::disconnect, seqno);
+        m.queue = atoi(argv[i + 1]);
+        return request(sock, device, &m, sizeof(m));
+    }
+    usage();
+    return 2;
+}
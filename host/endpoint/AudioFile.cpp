@@ -0,0 +1,134 @@
+#include "AudioFile.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// WAV files are little endian, like the hosts this tool runs on
+
+AudioSource::~AudioSource() {
+    if (f && f != stdin) fclose(f);
+}
+
+bool AudioSource::open(const std::string &spec) {
+    if (spec.compare(0, 5, "tone:") == 0) {
+        tone_hz = atof(spec.c_str() + 5);
+        return tone_hz > 0;
+    }
+    if (spec == "-") {
+        f = stdin;
+        return true;
+    }
+    if (spec.compare(0, 4, "raw:") == 0) {
+        f = fopen(spec.c_str() + 4, "rb");
+        if (!f) fprintf(stderr, "Cannot open %s\n", spec.c_str() + 4);
+        return f != nullptr;
+    }
+
+    f = fopen(spec.c_str(), "rb");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s\n", spec.c_str());
+        return false;
+    }
+    char riff[12];
+    if (fread(riff, 1, 12, f) != 12 || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+        fprintf(stderr, "%s is not a WAV file\n", spec.c_str());
+        return false;
+    }
+    bool have_fmt = false;
+    char id[4];
+    uint32_t size;
+    while (fread(id, 1, 4, f) == 4 && fread(&size, 4, 1, f) == 1) {
+        if (!memcmp(id, "fmt ", 4) && size >= 16) {
+            uint16_t format, bits;
+            uint32_t rate;
+            char fmt[16];
+            if (fread(fmt, 1, 16, f) != 16) break;
+            memcpy(&format, fmt, 2);
+            memcpy(&channels, fmt + 2, 2);
+            memcpy(&rate, fmt + 4, 4);
+            memcpy(&bits, fmt + 14, 2);
+            if (format != 1 || bits != 16 || channels < 1 || channels > 2) {
+                fprintf(stderr, "%s: only 16 bit PCM, mono or stereo is supported\n", spec.c_str());
+                return false;
+            }
+            if (rate != 44100) fprintf(stderr, "Warning: %s has %u Hz, it is played at 44100 Hz\n", spec.c_str(), rate);
+            have_fmt = true;
+            fseek(f, size - 16 + (size & 1), SEEK_CUR);
+        } else if (!memcmp(id, "data", 4) && have_fmt) {
+            data_start = ftell(f);
+            wav = true;
+            return true;
+        } else {
+            fseek(f, size + (size & 1), SEEK_CUR);
+        }
+    }
+    fprintf(stderr, "%s: no audio data\n", spec.c_str());
+    return false;
+}
+
+void AudioSource::read(int16_t *out, uint32_t n) {
+    if (tone_hz > 0) {
+        for (uint32_t i = 0; i < n; ++i, ++tone_pos) out[i] = 8000 * sin(2 * M_PI * tone_hz * tone_pos / 44100.0);
+        return;
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        int16_t s[2];
+        if (fread(s, 2, channels, f) != channels) {
+            if (!wav || fseek(f, data_start, SEEK_SET) || fread(s, 2, channels, f) != channels) {
+                // end of the pipe (or an empty WAV file): silence
+                memset(&out[i], 0, (n - i) * sizeof(int16_t));
+                return;
+            }
+        }
+        out[i] = (channels == 2) ? (s[0] + s[1]) / 2 : s[0];
+    }
+}
+
+AudioSink::~AudioSink() { close(); }
+
+bool AudioSink::open(const std::string &spec, uint32_t sample_rate) {
+    if (spec == "-") {
+        f = stdout;
+        return true;
+    }
+    wav = spec.compare(0, 4, "raw:") != 0;
+    f = fopen(wav ? spec.c_str() : spec.c_str() + 4, "wb");
+    if (!f) {
+        fprintf(stderr, "Cannot create %s\n", spec.c_str());
+        return false;
+    }
+    if (wav) {
+        // sizes are filled in by close()
+        uint8_t h[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0};
+        uint32_t byte_rate = sample_rate * 2;
+        uint16_t block_align = 2, bits = 16;
+        memcpy(h + 24, &sample_rate, 4);
+        memcpy(h + 28, &byte_rate, 4);
+        memcpy(h + 32, &block_align, 2);
+        memcpy(h + 34, &bits, 2);
+        memcpy(h + 36, "data", 4);
+        fwrite(h, 1, sizeof(h), f);
+    }
+    return true;
+}
+
+void AudioSink::write(const int16_t *in, uint32_t n) {
+    if (!f) return;
+    fwrite(in, sizeof(int16_t), n, f);
+    samples += n;
+}
+
+void AudioSink::close() {
+    if (!f) return;
+    if (wav) {
+        uint32_t data_size = samples * 2, riff_size = data_size + 36;
+        fseek(f, 4, SEEK_SET);
+        fwrite(&riff_size, 4, 1, f);
+        fseek(f, 40, SEEK_SET);
+        fwrite(&data_size, 4, 1, f);
+    }
+    if (f == stdout) fflush(f);
+    else fclose(f);
+    f = nullptr;
+}
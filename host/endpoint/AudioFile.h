@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+/**
+ * @brief Mono 16 bit audio for an endpoint's capture: a WAV file (played in a loop), raw samples from a pipe or a
+ *        generated tone
+ *
+ */
+class AudioSource {
+  public:
+    ~AudioSource();
+
+    /**
+     * @brief Open a source
+     *
+     * @param spec "tone:<hz>", "-" (raw signed 16 bit little endian mono samples on stdin), "raw:<path>" (the same
+     *             from a file or FIFO) or the path of a WAV file (PCM, 16 bit, mono or stereo; stereo is downmixed)
+     * @return bool false on errors (reported on stderr)
+     */
+    bool open(const std::string &spec);
+
+    /**
+     * @brief Read samples. A WAV file starts over at its end, a pipe that has ended delivers silence.
+     *
+     * @param out samples
+     * @param n number of samples
+     */
+    void read(int16_t *out, uint32_t n);
+
+  private:
+    FILE *f = nullptr;
+    bool wav = false;
+    uint16_t channels = 1;
+    long data_start = 0;
+    double tone_hz = 0;
+    uint64_t tone_pos = 0;
+};
+
+/**
+ * @brief Mono 16 bit audio of an endpoint's output: a WAV file or raw samples to a pipe
+ *
+ */
+class AudioSink {
+  public:
+    ~AudioSink();
+
+    /**
+     * @brief Open a sink
+     *
+     * @param spec "-" (raw signed 16 bit little endian mono samples to stdout), "raw:<path>" (the same to a file or
+     *             FIFO) or the path of a WAV file
+     * @param sample_rate sample rate of the WAV header
+     * @return bool false on errors (reported on stderr)
+     */
+    bool open(const std::string &spec, uint32_t sample_rate);
+
+    /**
+     * @brief Write samples
+     *
+     * @param in samples
+     * @param n number of samples
+     */
+    void write(const int16_t *in, uint32_t n);
+
+    /**
+     * @brief Finish the WAV header and close the file
+     *
+     */
+    void close();
+
+  private:
+    FILE *f = nullptr;
+    bool wav = false;
+    uint32_t samples = 0;
+};
@@ -0,0 +1,168 @@
+#include "Endpoint.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+
+static uint64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+Endpoint::Endpoint(const Impairment &imp, uint32_t seed) : impairment(imp), rng(seed) {
+    // the queues update before their mixer (the audio graph updates in construction order)
+    queues = new EndpointQueue[OPENREMJAM_MAX_PEERS];
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) queue_ptr[i] = &queues[i];
+    qc = new QueueController(queue_ptr);
+    capture_interval_us = OPENREMJAM_SAMPLES_PER_NETWORK_BLOCK * 1e6 / AUDIO_SAMPLE_RATE_EXACT / (1 + impairment.skew_ppm * 1e-6);
+    pcm_packets.resize(max_pending * OPENREMJAM_MONO_PACKET_SIZE);
+    adpcm_packets.resize(max_pending * OPENREMJAM_MONO_ADPCM_PACKET_SIZE);
+}
+
+Endpoint::~Endpoint() {
+    if (sock >= 0) close(sock);
+    // the queues and the QueueController stay in the audio graph, which has no removal
+}
+
+bool Endpoint::begin(uint16_t p, const std::string &input) {
+    port = p;
+    if (!source.open(input)) return false;
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        fprintf(stderr, "Cannot bind UDP port %u: %s\n", port, strerror(errno));
+        return false;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    int rcvbuf = 1 << 20; // dozens of peers on one host: do not drop bursts in the kernel
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    next_capture_us = HostClock::get() + capture_interval_us;
+    return true;
+}
+
+bool Endpoint::connect(IPAddress ip, uint16_t p) {
+    int qi = qc->getFreeQueueIndex();
+    if (qi < 0) return false;
+    return qc->connect(qi, ip, p);
+}
+
+void Endpoint::receive() {
+    // like receivePackets() in OpenRemjam.ino, but a datagram is read in one piece: the payload is copied into the
+    // queue's receive buffer instead of being read straight into it
+    uint8_t buf[2048] __attribute__((aligned(4)));
+    struct sockaddr_in from;
+    socklen_t from_len;
+    ssize_t packet_size;
+    while (from_len = sizeof(from), (packet_size = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len)) >= 0) {
+        uint64_t t0 = monotonicNs();
+        stats.rx_packets++;
+        if (packet_size < OPENREMJAM_HEADER_SIZE || from.sin_family != AF_INET) {
+            stats.rx_ignored++;
+            continue;
+        }
+        openremjam_header_t &header = *(openremjam_header_t *)buf;
+        uint16_t from_port = ntohs(from.sin_port);
+
+        int qi = qc->getQueueIndexByIPv4(from.sin_addr.s_addr, from_port);
+        if (qi < 0) {
+            qi = qc->getFreeAutoconnectQueueIndex();
+            if (qi >= 0 && header.type == PacketType::audio && qc->getQueue(qi)->isCompatible(header, packet_size) &&
+                qc->connect(qi, IPAddress(from.sin_addr.s_addr), from_port)) {
+                qc->getQueue(qi)->setSendCodec(header.codec);
+            } else {
+                qi = -1;
+            }
+        }
+
+        uint32_t t1 = CpuMeter::start();
+        uint8_t *payload = (qi >= 0) ? qc->getQueue(qi)->getPayloadBuffer(header, packet_size) : nullptr;
+        if (payload) {
+            memcpy(payload, &buf[OPENREMJAM_HEADER_SIZE], packet_size - OPENREMJAM_HEADER_SIZE);
+            qc->getQueue(qi)->commitPayload(header);
+        } else {
+            stats.rx_ignored++;
+        }
+        if (qi >= 0) qc->getQueue(qi)->getEnqueueCpu().stop(t1);
+        stats.rx_ns += monotonicNs() - t0;
+    }
+}
+
+void Endpoint::capture(uint64_t capture_us) {
+    uint32_t slot = seqno % max_pending;
+    uint8_t *pcm = &pcm_packets[slot * OPENREMJAM_MONO_PACKET_SIZE];
+    uint8_t *adpcm = &adpcm_packets[slot * OPENREMJAM_MONO_ADPCM_PACKET_SIZE];
+    source.read((int16_t *)&pcm[OPENREMJAM_HEADER_SIZE], OPENREMJAM_SAMPLES_PER_NETWORK_BLOCK);
+    fillHeader(*(openremjam_header_t *)pcm, PacketType::audio, Codec::pcm, seqno, OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK, 0);
+    // the coder runs for every block, so its state stays continuous when a remote host switches codecs
+    memcpy(adpcm, pcm, OPENREMJAM_HEADER_SIZE);
+    ((openremjam_header_t *)adpcm)->codec = Codec::adpcm;
+    ImaAdpcm::encode((int16_t *)&pcm[OPENREMJAM_HEADER_SIZE], OPENREMJAM_SAMPLES_PER_NETWORK_BLOCK,
+                     &adpcm[OPENREMJAM_HEADER_SIZE], adpcm_state);
+
+    if (std::uniform_real_distribution<double>(0, 1)(rng) < impairment.loss) {
+        stats.tx_lost++;
+    } else {
+        double delay = impairment.delay_us;
+        if (impairment.jitter_us > 0) delay += std::max(0.0, std::normal_distribution<double>(0, impairment.jitter_us)(rng));
+        pending.push(Pending{capture_us + (uint64_t)delay, seqno});
+    }
+    seqno++;
+}
+
+void Endpoint::sendTo(NetworkJitterBufferPlayQueue *q, uint8_t *buf, uint32_t size) {
+    if (q->hasIP6()) return; // IPv4 only
+    q->fillEcho(*(openremjam_header_t *)buf);
+    struct sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(q->getPort());
+    sa.sin_addr.s_addr = q->getIPv4();
+    if (sendto(sock, buf, size, 0, (struct sockaddr *)&sa, sizeof(sa)) >= 0) stats.tx_packets++;
+}
+
+void Endpoint::process(uint64_t now_us) {
+    if (qc->getServerMode()) {
+        // relay: each client gets its mix-minus, we have no signal of our own
+        MixMinusServer<OPENREMJAM_MAX_PEERS> *mm = qc->getMixMinus();
+        for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+            uint8_t *buf;
+            uint32_t size;
+            while ((buf = mm->getPacket(i, size)) != nullptr) {
+                if (qc->getQueue(i)->getPort()) sendTo(qc->getQueue(i), buf, size);
+                mm->releasePacket(i);
+            }
+        }
+        return;
+    }
+
+    while (next_capture_us <= now_us) {
+        capture(next_capture_us);
+        next_capture_us += capture_interval_us;
+    }
+    while (!pending.empty() && pending.top().departure_us <= now_us) {
+        Pending p = pending.top();
+        pending.pop();
+        uint32_t slot = p.seqno % max_pending;
+        uint8_t *pcm = &pcm_packets[slot * OPENREMJAM_MONO_PACKET_SIZE];
+        if (((openremjam_header_t *)pcm)->seqno != p.seqno) continue; // delayed so long that the slot was reused
+        uint8_t *adpcm = &adpcm_packets[slot * OPENREMJAM_MONO_ADPCM_PACKET_SIZE];
+        for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+            NetworkJitterBufferPlayQueue *q = qc->getQueue(i);
+            if (!q->getPort()) continue;
+            if (q->getSendCodec() == Codec::adpcm) sendTo(q, adpcm, OPENREMJAM_MONO_ADPCM_PACKET_SIZE);
+            else sendTo(q, pcm, OPENREMJAM_MONO_PACKET_SIZE);
+        }
+    }
+}
+
+uint64_t Endpoint::getNextEvent() {
+    if (qc->getServerMode()) return UINT64_MAX; // mix-minus packets are due after update_all()
+    uint64_t t = next_capture_us;
+    if (!pending.empty() && pending.top().departure_us < t) t = pending.top().departure_us;
+    return t;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "QueueController.h"
+#include "AudioFile.h"
+
+// the queues keep their slots: all endpoints of a process would share one NetworkBlockPool, sized for one device
+typedef NetworkJitterBufferRing<OPENREMJAM_PLAY_QUEUE_SIZE, OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK> EndpointQueue;
+
+/**
+ * @brief Network impairments injected into what an endpoint sends
+ *
+ */
+struct Impairment {
+  double delay_us = 0;            // extra one-way delay
+  double jitter_us = 0;           // standard deviation of the extra delay (normal distribution, cut off at 0)
+  double loss = 0;                // packet loss probability
+  double skew_ppm = 0;            // the endpoint's audio clock runs fast (> 0) or slow (< 0) by this much
+};
+
+/**
+ * @brief Counters of one endpoint
+ *
+ */
+struct EndpointStats {
+  uint64_t tx_packets = 0;        // datagrams sent (one per remote host and packet)
+  uint64_t tx_lost = 0;           // network blocks dropped by Impairment::loss
+  uint64_t rx_packets = 0;        // datagrams received
+  uint64_t rx_ignored = 0;        // no queue or not accepted by the queue (like the firmware, dropped silently)
+  uint64_t rx_ns = 0;             // time spent in the receive path (queue lookup, payload copy, commitPayload())
+};
+
+/**
+ * @brief One OpenRemjam endpoint on a POSIX UDP socket, doing what OpenRemjam.ino does on the Teensy:
+ *        capture -> network blocks with seqno -> fan-out to all connected remote hosts, and
+ *        receive -> queue of the remote host (QueueController, autoconnect) -> mix.
+ *        Several endpoints in one process stand in for several musicians (each has its own port, queues and audio
+ *        source). They share the audio graph, which the caller drives with AudioStream::update_all().
+ *
+ */
+class Endpoint {
+  public:
+    /**
+     * @brief Construct a new Endpoint object. Its queues and QueueController join the audio graph.
+     *
+     * @param impairment injected into what this endpoint sends
+     * @param seed random seed of the impairments
+     */
+    Endpoint(const Impairment &impairment, uint32_t seed);
+    ~Endpoint();
+
+    /**
+     * @brief Open the socket and the audio source
+     *
+     * @param port local UDP port, remote hosts identify us by it
+     * @param input audio source, see AudioSource::open()
+     * @return bool false on errors (reported on stderr)
+     */
+    bool begin(uint16_t port, const std::string &input);
+
+    /**
+     * @brief Connect the next free queue to a remote host (we send to it, and its packets go to this queue)
+     *
+     * @param ip remote IPv4 address
+     * @param port remote port
+     * @return bool false if no queue is free, or it gets no slots
+     */
+    bool connect(IPAddress ip, uint16_t port);
+
+    /**
+     * @brief Receive all pending datagrams
+     *
+     */
+    void receive();
+
+    /**
+     * @brief Capture the network blocks that are due and send the packets whose (impaired) departure time has come
+     *
+     * @param now_us current time (HostClock)
+     */
+    void process(uint64_t now_us);
+
+    /**
+     * @brief Time of the next capture or departure, see process()
+     *
+     * @return uint64_t time in microseconds (HostClock)
+     */
+    uint64_t getNextEvent();
+
+    int getSocket() { return sock; }
+    uint16_t getPort() { return port; }
+    QueueController &getQueueController() { return *qc; }
+    const EndpointStats &getStats() { return stats; }
+
+  private:
+    struct Pending {
+      uint64_t departure_us;
+      uint32_t seqno;
+      bool operator>(const Pending &p) const { return departure_us > p.departure_us; }
+    };
+
+    void capture(uint64_t capture_us);
+    void sendTo(NetworkJitterBufferPlayQueue *q, uint8_t *buf, uint32_t size);
+
+    Impairment impairment;
+    std::mt19937 rng;
+    int sock = -1;
+    uint16_t port = 0;
+    AudioSource source;
+    EndpointQueue *queues;
+    NetworkJitterBufferPlayQueue *queue_ptr[OPENREMJAM_MAX_PEERS];
+    QueueController *qc;
+    EndpointStats stats;
+
+    double capture_interval_us;   // network block duration on this endpoint's (skewed) clock
+    double next_capture_us = 0;
+    uint32_t seqno = 0;
+    ima_adpcm_state_t adpcm_state = {0, 0};
+
+    // captured network blocks waiting for their departure time: PCM and IMA-ADPCM packet of each, by seqno
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> pending;
+    std::vector<uint8_t> pcm_packets;
+    std::vector<uint8_t> adpcm_packets;
+    static const uint32_t max_pending = 256;  // network blocks (> 700 ms)
+};
@@ -0,0 +1,378 @@
+// openremjam-endpoint: OpenRemjam endpoints on Linux (POSIX UDP, audio from/to WAV files or pipes). One process can
+// run many synthetic peers with injected jitter, loss and clock skew, e.g. as a load generator against a Teensy.
+// See README.md, section "Linux endpoint and load generator".
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "Endpoint.h"
+
+/**
+ * @brief Writes the blocks of its input to an AudioSink, silence if there is none
+ *
+ */
+class OutputWriter : public AudioStream {
+  public:
+    OutputWriter(AudioSink &s) : AudioStream(1, inputQueueArray), sink(s) {}
+
+    virtual void update(void) {
+      static const int16_t silence[AUDIO_BLOCK_SAMPLES] = {};
+      audio_block_t *block = receiveReadOnly(0);
+      sink.write(block ? block->data : silence, AUDIO_BLOCK_SAMPLES);
+      if (block) release(block);
+    }
+
+  private:
+    AudioSink &sink;
+    audio_block_t *inputQueueArray[1];
+};
+
+/**
+ * @brief Totals of the queues of one endpoint
+ *
+ */
+struct QueueTotals {
+  uint32_t queues = 0;
+  uint32_t late = 0;
+  uint32_t early = 0;
+  uint32_t concealed = 0;
+  uint32_t recoveries_success = 0;
+  uint32_t recoveries_failed = 0;
+  uint32_t fec_recovered = 0;
+  uint32_t rejected = 0;
+  uint32_t jitter_max = 0;
+  uint32_t latency_max = 0;
+
+  uint32_t glitches() const { return concealed + recoveries_failed; }
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int) { running = 0; }
+
+static uint64_t monotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static void usage() {
+    printf("Usage: openremjam-endpoint [options]\r\n"
+           "Endpoint:\r\n"
+           "  --port N            local UDP port of peer 1, peer k uses port + k - 1 (default %d)\r\n"
+           "  --connect IP:PORT   send to this remote host (repeatable); any host that sends to us is connected, too\r\n"
+           "  --peers N           endpoints in this process (default 1), each with its own port, queues and audio\r\n"
+           "  --input SPEC        audio of peer 1: WAV file, - or raw:PATH (raw s16le mono), tone:HZ (default tone:440).\r\n"
+           "                      The other peers play the same WAV file, or a tone of their own\r\n"
+           "  --output SPEC       mix of peer 1: WAV file, - or raw:PATH (raw s16le mono)\r\n"
+           "  --codec pcm|adpcm   codec sent to the --connect hosts (default pcm)\r\n"
+           "  --server            peer 1 relays: each remote host receives the mix of all others (mix-minus)\r\n"
+           "  --duration S        run time in seconds, 0: until Ctrl-C (default 0)\r\n"
+           "Impairments of what we send (all peers):\r\n"
+           "  --delay US          extra one-way delay (default 0)\r\n"
+           "  --jitter US         standard deviation of the extra delay (default 0)\r\n"
+           "  --loss P            packet loss probability (default 0)\r\n"
+           "  --skew PPM          audio clock skew (default 0)\r\n"
+           "  --seed N            random seed of peer 1 (default 1)\r\n"
+           "  --peer K:LIST       impairments of peer K, e.g. 2:jitter=800,loss=0.01,skew=-40,delay=2000\r\n"
+           "Queue:\r\n"
+           "  --max-buffers N     setMaxBuffers(N)\r\n"
+           "  --prefill N         setPrefill(N) (after --max-buffers)\r\n"
+           "  --adaptive          enable the adaptive buffer depth\r\n"
+           "  --no-drift-comp     disable the clock drift compensation\r\n"
+           "Output:\r\n"
+           "  --interval S        seconds between throughput reports, 0: none (default 1)\r\n"
+           "  --csv               per-peer summary as CSV\r\n"
+           "  --verbose           show the firmware's serial output and the periodic queue statistics\r\n"
+           "  --max-glitches N    exit with status 1 if a peer has more than N glitches\r\n",
+           OPENREMJAM_DEFAULT_UDP_PORT);
+}
+
+static bool parsePeer(const char *v, std::vector<std::pair<int, Impairment>> &overrides, const Impairment &defaults) {
+    char *end;
+    long k = strtol(v, &end, 10);
+    if (k < 1 || *end != ':') return false;
+    Impairment imp = defaults;
+    std::string list(end + 1);
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t comma = list.find(',', pos);
+        std::string item = list.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        std::string key = item.substr(0, eq);
+        double val = atof(item.c_str() + eq + 1);
+        if (key == "delay") imp.delay_us = val;
+        else if (key == "jitter") imp.jitter_us = val;
+        else if (key == "loss") imp.loss = val;
+        else if (key == "skew") imp.skew_ppm = val;
+        else return false;
+        if (comma == std::string::npos) break;
+        pos = comma + 1;
+    }
+    overrides.push_back(std::make_pair((int)k, imp));
+    return true;
+}
+
+static QueueTotals totals(QueueController &qc) {
+    QueueTotals t;
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+        NetworkJitterBufferPlayQueue *q = qc.getQueue(i);
+        if (!q->getPort()) continue;
+        t.queues++;
+        t.late += q->getLatePackets();
+        t.early += q->getEarlyPackets();
+        t.concealed += q->getConcealedPackets();
+        t.recoveries_success += q->getRecoveriesSuccess();
+        t.recoveries_failed += q->getRecoveriesFailed();
+        t.fec_recovered += q->getFecRecoveredPackets();
+        t.rejected += q->getRejectedPackets();
+        if (q->getJitter() > t.jitter_max) t.jitter_max = q->getJitter();
+        if (q->getLatency().getAvg() > t.latency_max) t.latency_max = q->getLatency().getAvg();
+    }
+    return t;
+}
+
+int main(int argc, char **argv) {
+    uint16_t port = OPENREMJAM_DEFAULT_UDP_PORT;
+    std::vector<std::pair<IPAddress, uint16_t>> remotes;
+    int peer_count = 1;
+    std::string input = "tone:440";
+    std::string output;
+    bool adpcm = false;
+    bool server = false;
+    double duration_s = 0;
+    Impairment defaults;
+    std::vector<std::pair<int, Impairment>> overrides;
+    std::vector<const char *> peer_args;
+    uint32_t seed = 1;
+    int max_buffers = -1;
+    int prefill = -1;
+    bool adaptive = false;
+    bool drift_compensation = true;
+    double interval_s = 1;
+    bool csv = false;
+    bool verbose = false;
+    long max_glitches = -1;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool takes_value = true;
+        if (!strcmp(a, "--port") && v) port = atoi(v);
+        else if (!strcmp(a, "--connect") && v) {
+            char ip_string[32];
+            unsigned int remote_port;
+            IPAddress ip;
+            if (sscanf(v, "%31[0-9.]:%u", ip_string, &remote_port) != 2 || !ip.fromString(ip_string) || remote_port < 1 || remote_port > 65535) {
+                usage();
+                return 2;
+            }
+            remotes.push_back(std::make_pair(ip, (uint16_t)remote_port));
+        }
+        else if (!strcmp(a, "--peers") && v) peer_count = atoi(v);
+        else if (!strcmp(a, "--input") && v) input = v;
+        else if (!strcmp(a, "--output") && v) output = v;
+        else if (!strcmp(a, "--codec") && v) adpcm = !strcmp(v, "adpcm");
+        else if (!strcmp(a, "--duration") && v) duration_s = atof(v);
+        else if (!strcmp(a, "--delay") && v) defaults.delay_us = atof(v);
+        else if (!strcmp(a, "--jitter") && v) defaults.jitter_us = atof(v);
+        else if (!strcmp(a, "--loss") && v) defaults.loss = atof(v);
+        else if (!strcmp(a, "--skew") && v) defaults.skew_ppm = atof(v);
+        else if (!strcmp(a, "--seed") && v) seed = atoi(v);
+        else if (!strcmp(a, "--peer") && v) peer_args.push_back(v);
+        else if (!strcmp(a, "--max-buffers") && v) max_buffers = atoi(v);
+        else if (!strcmp(a, "--prefill") && v) prefill = atoi(v);
+        else if (!strcmp(a, "--interval") && v) interval_s = atof(v);
+        else if (!strcmp(a, "--max-glitches") && v) max_glitches = atol(v);
+        else {
+            takes_value = false;
+            if (!strcmp(a, "--server")) server = true;
+            else if (!strcmp(a, "--adaptive")) adaptive = true;
+            else if (!strcmp(a, "--no-drift-comp")) drift_compensation = false;
+            else if (!strcmp(a, "--csv")) csv = true;
+            else if (!strcmp(a, "--verbose")) verbose = true;
+            else {
+                usage();
+                return strcmp(a, "--help") ? 2 : 0;
+            }
+        }
+        if (takes_value) ++i;
+    }
+    // --peer overrides start from the final defaults, whatever the order of the options
+    for (const char *v : peer_args) {
+        if (!parsePeer(v, overrides, defaults)) {
+            usage();
+            return 2;
+        }
+    }
+    if (peer_count < 1 || port + peer_count - 1 > 65535) {
+        usage();
+        return 2;
+    }
+
+    // stdout may carry the output audio
+    FILE *report = (output == "-") ? stderr : stdout;
+    Serial.setEnabled(verbose && output != "-");
+
+    // HostClock runs in real time, starting at 1 s (a timestamp of 0 means "none" in the echo fields)
+    const uint64_t start_us = monotonicUs() - 1000000;
+    HostClock::set(monotonicUs() - start_us);
+
+    std::vector<audio_block_t> pool(peer_count * OPENREMJAM_AUDIO_MEMORY + 10);
+    AudioStream::initialize_memory(pool.data(), pool.size());
+
+    std::vector<Endpoint *> peers;
+    bool input_is_wav = input != "-" && input.compare(0, 4, "raw:") != 0 && input.compare(0, 5, "tone:") != 0;
+    for (int p = 0; p < peer_count; ++p) {
+        Impairment imp = defaults;
+        for (auto &o : overrides) {
+            if (o.first == p + 1) imp = o.second;
+        }
+        Endpoint *e = new Endpoint(imp, seed + p);
+        std::string peer_input = (p == 0 || input_is_wav) ? input : "tone:" + std::to_string(440 + 55 * p);
+        if (!e->begin(port + p, peer_input)) return 2;
+        QueueController &qc = e->getQueueController();
+        for (auto &r : remotes) {
+            if (!e->connect(r.first, r.second)) {
+                fprintf(stderr, "Too many remote hosts (at most %d)\n", OPENREMJAM_MAX_PEERS - 1);
+                return 2;
+            }
+        }
+        for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) {
+            NetworkJitterBufferPlayQueue *q = qc.getQueue(i);
+            if (q->getPort()) q->setSendCodec(adpcm ? Codec::adpcm : Codec::pcm);
+            if (max_buffers > 0) q->setMaxBuffers(max_buffers);
+            if (prefill > 0) q->setPrefill(prefill);
+            q->setAdaptive(adaptive);
+            q->setDriftCompensation(drift_compensation);
+        }
+        if (server && p == 0) qc.setServerMode(true);
+        peers.push_back(e);
+    }
+
+    // peer 1's mix (constructed last: updates after the queues)
+    AudioSink sink;
+    if (!output.empty()) {
+        if (!sink.open(output, OPENREMJAM_SAMPLE_RATE)) return 2;
+        AudioMixerMulti<OPENREMJAM_MAX_PEERS> *out_mixer = new AudioMixerMulti<OPENREMJAM_MAX_PEERS>();
+        OutputWriter *writer = new OutputWriter(sink);
+        for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) new AudioConnection(*peers[0]->getQueueController().getQueue(i), 0, *out_mixer, i);
+        new AudioConnection(*out_mixer, 0, *writer, 0);
+    }
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    std::vector<struct pollfd> fds(peer_count);
+    for (int p = 0; p < peer_count; ++p) fds[p] = {peers[p]->getSocket(), POLLIN, 0};
+
+    const double block_us = AUDIO_BLOCK_SAMPLES * 1e6 / AUDIO_SAMPLE_RATE_EXACT;
+    const uint64_t begin_us = HostClock::get();
+    double next_tick_us = begin_us;
+    uint64_t next_report_us = begin_us + (uint64_t)(interval_s * 1e6);
+    uint64_t overruns = 0;
+    uint64_t last_tx = 0, last_rx = 0, last_rx_ns = 0;
+
+    while (running) {
+        uint64_t now = monotonicUs() - start_us;
+        uint64_t next = (uint64_t)next_tick_us;
+        for (Endpoint *e : peers) {
+            if (e->getNextEvent() < next) next = e->getNextEvent();
+        }
+        struct timespec timeout = {0, 0};
+        if (next > now) {
+            timeout.tv_sec = (next - now) / 1000000;
+            timeout.tv_nsec = ((next - now) % 1000000) * 1000;
+        }
+        int ready = ppoll(fds.data(), fds.size(), &timeout, nullptr);
+        now = monotonicUs() - start_us;
+        HostClock::set(now);
+
+        if (ready > 0) {
+            for (int p = 0; p < peer_count; ++p) {
+                if (fds[p].revents & POLLIN) peers[p]->receive();
+            }
+        }
+
+        // the audio clock: one update_all() per audio block
+        while (next_tick_us <= now) {
+            AudioStream::update_all();
+            next_tick_us += block_us;
+            if (now - next_tick_us > 20000) {
+                // more than 20 ms behind (host overloaded or suspended): skip ahead instead of catching up
+                overruns++;
+                next_tick_us = now;
+            }
+        }
+
+        for (Endpoint *e : peers) e->process(now);
+
+        EventLog::flush();
+        if (verbose) {
+            for (Endpoint *e : peers) e->getQueueController().printStatisticsIfDue();
+        }
+
+        if (interval_s > 0 && now >= next_report_us) {
+            uint64_t tx = 0, rx = 0, rx_ns = 0;
+            uint32_t glitches = 0;
+            for (Endpoint *e : peers) {
+                tx += e->getStats().tx_packets;
+                rx += e->getStats().rx_packets;
+                rx_ns += e->getStats().rx_ns;
+                glitches += totals(e->getQueueController()).glitches();
+            }
+            fprintf(report, "%7.1f s: tx %6.0f packets/s, rx %6.0f packets/s, receive path %6.2f us/packet, audio cycle %5.2f%% (peak %5.2f%%), glitches %u, overruns %llu\r\n",
+                    (now - begin_us) / 1e6, (tx - last_tx) / interval_s, (rx - last_rx) / interval_s,
+                    rx > last_rx ? (rx_ns - last_rx_ns) / 1000.0 / (rx - last_rx) : 0.0, AudioProcessorUsage(), AudioProcessorUsageMax(),
+                    glitches, (unsigned long long)overruns);
+            last_tx = tx;
+            last_rx = rx;
+            last_rx_ns = rx_ns;
+            next_report_us += (uint64_t)(interval_s * 1e6);
+        }
+
+        if (duration_s > 0 && now - begin_us >= duration_s * 1e6) break;
+    }
+    sink.close();
+
+    double elapsed_s = (HostClock::get() - begin_us) / 1e6;
+    if (csv) {
+        fprintf(report, "peer,port,queues,tx,tx_lost,rx,rx_ignored,late,early,concealed,recoveries_success,recoveries_failed,"
+                        "fec_recovered,rejected,jitter_max_us,latency_max_us,glitches\r\n");
+    }
+    int status = 0;
+    uint64_t tx = 0, rx = 0, rx_ns = 0;
+    for (int p = 0; p < peer_count; ++p) {
+        const EndpointStats &s = peers[p]->getStats();
+        QueueTotals t = totals(peers[p]->getQueueController());
+        tx += s.tx_packets;
+        rx += s.rx_packets;
+        rx_ns += s.rx_ns;
+        if (max_glitches >= 0 && t.glitches() > (uint32_t)max_glitches) status = 1;
+        if (csv) {
+            fprintf(report, "%d,%u,%u,%llu,%llu,%llu,%llu,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\r\n",
+                    p + 1, peers[p]->getPort(), t.queues, (unsigned long long)s.tx_packets, (unsigned long long)s.tx_lost,
+                    (unsigned long long)s.rx_packets, (unsigned long long)s.rx_ignored, t.late, t.early, t.concealed,
+                    t.recoveries_success, t.recoveries_failed, t.fec_recovered, t.rejected, t.jitter_max, t.latency_max,
+                    t.glitches());
+        } else {
+            fprintf(report, "Peer %3d (port %5u): queues %2u, tx %8llu (lost %llu), rx %8llu (ignored %llu), late %u, early %u, "
+                            "concealed %u, recoveries %u/%u, fec %u, rejected %u, jitter %u us, latency %u us, glitches %u\r\n",
+                    p + 1, peers[p]->getPort(), t.queues, (unsigned long long)s.tx_packets, (unsigned long long)s.tx_lost,
+                    (unsigned long long)s.rx_packets, (unsigned long long)s.rx_ignored, t.late, t.early, t.concealed,
+                    t.recoveries_success, t.recoveries_failed, t.fec_recovered, t.rejected, t.jitter_max, t.latency_max,
+                    t.glitches());
+        }
+    }
+    if (!csv && elapsed_s > 0) {
+        fprintf(report, "Total: %.1f s, tx %.0f packets/s, rx %.0f packets/s, receive path %.2f us/packet, audio cycle peak %.2f%%, overruns %llu\r\n",
+                elapsed_s, tx / elapsed_s, rx / elapsed_s, rx ? rx_ns / 1000.0 / rx : 0.0, AudioProcessorUsageMax(), (unsigned long long)overruns);
+    }
+    return status;
+}
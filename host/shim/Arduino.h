@@ -0,0 +1,95 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino/Teensyduino core that OpenRemjam uses.
+// Time is virtual: micros() and millis() return the value set via HostClock, so a
+// simulator can drive the firmware code deterministically.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include "WString.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 1
+#define INPUT 0
+
+/**
+ * @brief Virtual clock behind micros() and millis()
+ *
+ */
+class HostClock {
+  public:
+    /**
+     * @brief Set the current time
+     *
+     * @param us time in microseconds
+     */
+    static void set(uint64_t us);
+
+    /**
+     * @brief Get the current time
+     *
+     * @return uint64_t time in microseconds
+     */
+    static uint64_t get();
+
+  private:
+    static uint64_t now_us;
+};
+
+uint32_t micros(void);
+uint32_t millis(void);
+
+// the DWT cycle counter and the CPU clock: a nanosecond counter that runs in real time (unlike micros()), so the
+// CPU accounting measures what the code costs on the host
+uint32_t hostCycleCount(void);
+#define ARM_DWT_CYCCNT (hostCycleCount())
+#define F_CPU_ACTUAL (1000000000)
+
+// memory placement of the Teensy 4 (RAM2, PSRAM): one memory on the host
+#define DMAMEM
+#define EXTMEM
+
+// the fuse registers that hold the MAC address of the Teensy 4.1
+#define HW_OCOTP_MAC0 (0x12345678u)
+#define HW_OCOTP_MAC1 (0x0000aabbu)
+
+void delay(uint32_t ms);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+
+/**
+ * @brief Serial console stand-in. Output goes to stdout and can be muted.
+ *
+ */
+class HostSerial {
+  public:
+    void begin(uint32_t baud) {}
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char *s);
+    size_t print(int n);
+    size_t println(const char *s);
+    size_t println(int n);
+    size_t println(void);
+    int available(void) { return 0; }
+    int read(void) { return -1; }
+    operator bool() { return true; }
+
+    /**
+     * @brief Enable or disable console output
+     *
+     * @param val true: print to stdout, false: discard
+     */
+    void setEnabled(bool val) { enabled = val; }
+
+  private:
+    bool enabled = true;
+};
+
+extern HostSerial Serial;
@@ -0,0 +1,165 @@
+#pragma once
+
+// Host stand-in for the Teensy Audio library. It mirrors the block pool, the reference
+// counting and the transmit/receive semantics of AudioStream closely enough that the
+// play queue and the mixer graph behave like on the Teensy. update_all() runs one audio
+// cycle synchronously instead of triggering the software interrupt.
+
+#include "Arduino.h"
+
+#ifndef AUDIO_BLOCK_SAMPLES
+#define AUDIO_BLOCK_SAMPLES 16
+#endif
+
+#ifndef AUDIO_SAMPLE_RATE_EXACT
+#define AUDIO_SAMPLE_RATE_EXACT 44117.64706f
+#endif
+#define AUDIO_SAMPLE_RATE AUDIO_SAMPLE_RATE_EXACT
+
+class AudioStream;
+class AudioConnection;
+
+typedef struct audio_block_struct {
+  uint8_t  ref_count;
+  uint8_t  reserved1;
+  uint16_t memory_pool_index;
+  int16_t  data[AUDIO_BLOCK_SAMPLES];
+} audio_block_t;
+
+class AudioConnection {
+  public:
+    AudioConnection();
+    AudioConnection(AudioStream &source, AudioStream &destination);
+    AudioConnection(AudioStream &source, unsigned char sourceOutput,
+                    AudioStream &destination, unsigned char destinationInput);
+    int connect(AudioStream &source, unsigned char sourceOutput,
+                AudioStream &destination, unsigned char destinationInput);
+    friend class AudioStream;
+
+  protected:
+    int connect(void);
+    AudioStream *src;
+    AudioStream *dst;
+    unsigned char src_index;
+    unsigned char dest_index;
+    AudioConnection *next_dest;
+};
+
+#define AudioMemory(num) ({ \
+    static audio_block_t data[num]; \
+    AudioStream::initialize_memory(data, num); \
+})
+
+#define AudioMemoryUsage() (AudioStream::memory_used)
+#define AudioMemoryUsageMax() (AudioStream::memory_used_max)
+#define AudioMemoryUsageMaxReset() (AudioStream::memory_used_max = AudioStream::memory_used)
+
+// processor usage in percent of one audio block, like the Teensy Audio library (cycles are counted in units of 64)
+#define CYCLE_COUNTER_APPROX_PERCENT(n) (((float)((uint32_t)(n) * 6400u) * (float)(AUDIO_SAMPLE_RATE_EXACT / AUDIO_BLOCK_SAMPLES)) / (float)(F_CPU_ACTUAL))
+#define AudioProcessorUsage() (CYCLE_COUNTER_APPROX_PERCENT(AudioStream::cpu_cycles_total))
+#define AudioProcessorUsageMax() (CYCLE_COUNTER_APPROX_PERCENT(AudioStream::cpu_cycles_total_max))
+#define AudioProcessorUsageMaxReset() (AudioStream::cpu_cycles_total_max = AudioStream::cpu_cycles_total)
+
+// update_all() runs synchronously, there is no audio interrupt to mask
+#define AudioNoInterrupts()
+#define AudioInterrupts()
+
+class AudioStream {
+  public:
+    AudioStream(unsigned char ninput, audio_block_t **iqueue);
+    virtual ~AudioStream() {}
+    static void initialize_memory(audio_block_t *data, unsigned int num);
+    static uint16_t memory_used;
+    static uint16_t memory_used_max;
+    static uint16_t cpu_cycles_total;
+    static uint16_t cpu_cycles_total_max;
+
+    /**
+     * @brief Run one audio cycle: call update() of every active stream in construction order
+     *
+     */
+    static void update_all(void);
+
+    bool isActive(void) { return active; }
+    float processorUsage(void) { return CYCLE_COUNTER_APPROX_PERCENT(cpu_cycles); }
+    float processorUsageMax(void) { return CYCLE_COUNTER_APPROX_PERCENT(cpu_cycles_max); }
+    void processorUsageMaxReset(void) { cpu_cycles_max = cpu_cycles; }
+    uint16_t cpu_cycles;
+    uint16_t cpu_cycles_max;
+
+  protected:
+    bool active;
+    unsigned char num_inputs;
+    static audio_block_t *allocate(void);
+    static void release(audio_block_t *block);
+    void transmit(audio_block_t *block, unsigned char index = 0);
+    audio_block_t *receiveReadOnly(unsigned int index = 0);
+    audio_block_t *receiveWritable(unsigned int index = 0);
+    friend class AudioConnection;
+
+  private:
+    virtual void update(void) = 0;
+    AudioConnection *destination_list;
+    audio_block_t **inputQueue;
+    AudioStream *next_update;
+    static AudioStream *first_update;
+    static audio_block_t *memory_pool;
+    static unsigned int memory_pool_size;
+    static audio_block_t **memory_free;
+    static unsigned int memory_free_count;
+};
+
+class AudioMixer4 : public AudioStream {
+  public:
+    AudioMixer4(void) : AudioStream(4, inputQueueArray) {
+      for (int i = 0; i < 4; i++) multiplier[i] = 65536;
+    }
+    virtual void update(void);
+    void gain(unsigned int channel, float gain) {
+      if (channel >= 4) return;
+      if (gain > 32767.0f) gain = 32767.0f;
+      else if (gain < -32767.0f) gain = -32767.0f;
+      multiplier[channel] = gain * 65536.0f;
+    }
+
+  private:
+    int32_t multiplier[4];
+    audio_block_t *inputQueueArray[4];
+};
+
+class AudioOutputI2S : public AudioStream {
+  public:
+    AudioOutputI2S(void) : AudioStream(2, inputQueueArray) {}
+    virtual void update(void);
+
+  private:
+    audio_block_t *inputQueueArray[2];
+};
+
+// Declared for the sketch compile check (make sketch), the simulator and the endpoint feed the queues directly.
+class AudioInputI2S : public AudioStream {
+  public:
+    AudioInputI2S(void) : AudioStream(0, nullptr) {}
+    virtual void update(void);
+};
+
+class AudioRecordQueue : public AudioStream {
+  public:
+    AudioRecordQueue(void) : AudioStream(1, inputQueueArray) {}
+    void begin(void);
+    void end(void);
+    void clear(void);
+    int available(void);
+    int16_t *readBuffer(void);
+    void freeBuffer(void);
+    virtual void update(void);
+
+  private:
+    audio_block_t *inputQueueArray[1];
+};
+
+class AudioControlSGTL5000 {
+  public:
+    bool enable(void);
+    bool volume(float n);
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "CmdParser.hpp"
+
+class CmdBufferObject {
+  public:
+    bool readFromSerial(HostSerial *serial, uint32_t timeOut = 0);
+};
+
+template <size_t BUFFERSIZE>
+class CmdBuffer : public CmdBufferObject {
+  private:
+    uint8_t buffer[BUFFERSIZE];
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "CmdParser.hpp"
+#include "CmdBuffer.hpp"
+
+typedef void (*CmdCallFunct)(CmdParser *cmdParser);
+
+class CmdCallbackObject {
+  public:
+    bool processCmd(CmdParser *cmdParser);
+    void updateCmdProcessing(CmdParser *cmdParser, CmdBufferObject *cmdBuffer, HostSerial *serial);
+};
+
+template <size_t STORESIZE>
+class CmdCallback : public CmdCallbackObject {
+  public:
+    bool addCmd(const char *cmdStr, CmdCallFunct cbFunct);
+
+  private:
+    const char *cmds[STORESIZE];
+    CmdCallFunct functs[STORESIZE];
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-ins for the CmdParser library (CmdParser, CmdBuffer, CmdCallback). Declared for the sketch compile
+// check (make sketch), nothing on the host links against them.
+
+#include "Arduino.h"
+
+class CmdParser {
+  public:
+    const char *getCmdParam(size_t idx);
+    size_t getParamCount();
+};
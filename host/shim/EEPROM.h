@@ -0,0 +1,32 @@
+#pragma once
+
+// Host stand-in for the emulated EEPROM of the Teensy 4.1 (4284 bytes). Declared for the sketch compile check
+// (make sketch), nothing on the host links against it.
+
+#include "Arduino.h"
+
+#define E2END 0x10BB
+
+class EEPROMClass {
+  public:
+    uint8_t read(int idx);
+    void write(int idx, uint8_t val);
+    void update(int idx, uint8_t val);
+    uint16_t length() { return E2END + 1; }
+
+    template <typename T>
+    T &get(int idx, T &t) {
+      uint8_t *p = (uint8_t *)&t;
+      for (unsigned int k = 0; k < sizeof(T); ++k) p[k] = read(idx + k);
+      return t;
+    }
+
+    template <typename T>
+    const T &put(int idx, const T &t) {
+      const uint8_t *p = (const uint8_t *)&t;
+      for (unsigned int k = 0; k < sizeof(T); ++k) update(idx + k, p[k]);
+      return t;
+    }
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,13 @@
+#pragma once
+
+// Host stand-in for the Teensy Entropy library. Declared for the sketch compile check (make sketch).
+
+#include "Arduino.h"
+
+class EntropyClass {
+  public:
+    void Initialize();
+    uint32_t random();
+};
+
+extern EntropyClass Entropy;
@@ -0,0 +1,227 @@
+#include "Arduino.h"
+#include "Audio.h"
+
+#include <time.h>
+
+/***** Arduino core ****/
+
+uint64_t HostClock::now_us = 0;
+
+void HostClock::set(uint64_t us) { now_us = us; }
+
+uint64_t HostClock::get() { return now_us; }
+
+uint32_t micros(void) { return (uint32_t)HostClock::get(); }
+
+uint32_t millis(void) { return (uint32_t)(HostClock::get() / 1000); }
+
+uint32_t hostCycleCount(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+void delay(uint32_t ms) { HostClock::set(HostClock::get() + (uint64_t)ms * 1000); }
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t val) {}
+
+HostSerial Serial;
+
+int HostSerial::printf(const char *format, ...) {
+    if (!enabled) return 0;
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    return n;
+}
+
+size_t HostSerial::print(const char *s) { return printf("%s", s); }
+
+size_t HostSerial::print(int n) { return printf("%d", n); }
+
+size_t HostSerial::println(const char *s) { return printf("%s\r\n", s); }
+
+size_t HostSerial::println(int n) { return printf("%d\r\n", n); }
+
+size_t HostSerial::println(void) { return printf("\r\n"); }
+
+/***** Audio library ****/
+
+uint16_t AudioStream::memory_used = 0;
+uint16_t AudioStream::memory_used_max = 0;
+uint16_t AudioStream::cpu_cycles_total = 0;
+uint16_t AudioStream::cpu_cycles_total_max = 0;
+AudioStream *AudioStream::first_update = nullptr;
+audio_block_t *AudioStream::memory_pool = nullptr;
+unsigned int AudioStream::memory_pool_size = 0;
+audio_block_t **AudioStream::memory_free = nullptr;
+unsigned int AudioStream::memory_free_count = 0;
+
+AudioStream::AudioStream(unsigned char ninput, audio_block_t **iqueue)
+    : cpu_cycles(0), cpu_cycles_max(0), active(false), num_inputs(ninput), destination_list(nullptr), inputQueue(iqueue), next_update(nullptr) {
+    for (int i = 0; i < num_inputs; i++) {
+        inputQueue[i] = nullptr;
+    }
+    // add to a simple list, for update_all (same order as on the Teensy)
+    if (!first_update) {
+        first_update = this;
+    } else {
+        AudioStream *p;
+        for (p = first_update; p->next_update; p = p->next_update);
+        p->next_update = this;
+    }
+}
+
+void AudioStream::initialize_memory(audio_block_t *data, unsigned int num) {
+    memory_pool = data;
+    memory_pool_size = num;
+    memory_free = new audio_block_t *[num];
+    memory_free_count = 0;
+    for (unsigned int i = 0; i < num; i++) {
+        data[i].memory_pool_index = i;
+        data[i].ref_count = 0;
+        memory_free[memory_free_count++] = &data[i];
+    }
+    memory_used = 0;
+    memory_used_max = 0;
+}
+
+audio_block_t *AudioStream::allocate(void) {
+    if (!memory_free_count) return nullptr;
+    audio_block_t *block = memory_free[--memory_free_count];
+    block->ref_count = 1;
+    if (++memory_used > memory_used_max) memory_used_max = memory_used;
+    return block;
+}
+
+void AudioStream::release(audio_block_t *block) {
+    if (block->ref_count > 1) {
+        block->ref_count--;
+    } else {
+        block->ref_count = 0;
+        memory_free[memory_free_count++] = block;
+        memory_used--;
+    }
+}
+
+void AudioStream::transmit(audio_block_t *block, unsigned char index) {
+    for (AudioConnection *c = destination_list; c != nullptr; c = c->next_dest) {
+        if (c->src_index == index) {
+            if (c->dst->inputQueue[c->dest_index] == nullptr) {
+                c->dst->inputQueue[c->dest_index] = block;
+                block->ref_count++;
+            }
+        }
+    }
+}
+
+audio_block_t *AudioStream::receiveReadOnly(unsigned int index) {
+    if (index >= num_inputs) return nullptr;
+    audio_block_t *in = inputQueue[index];
+    inputQueue[index] = nullptr;
+    return in;
+}
+
+audio_block_t *AudioStream::receiveWritable(unsigned int index) {
+    if (index >= num_inputs) return nullptr;
+    audio_block_t *in = inputQueue[index];
+    inputQueue[index] = nullptr;
+    if (in && in->ref_count > 1) {
+        audio_block_t *p = allocate();
+        if (p) memcpy(p->data, in->data, sizeof(p->data));
+        in->ref_count--;
+        in = p;
+    }
+    return in;
+}
+
+void AudioStream::update_all(void) {
+    // the CPU accounting of the Teensy's software interrupt: cycles / 64 per stream and for the whole cycle
+    uint32_t totalcycles = ARM_DWT_CYCCNT;
+    for (AudioStream *p = first_update; p; p = p->next_update) {
+        if (p->active) {
+            uint32_t cycles = ARM_DWT_CYCCNT;
+            p->update();
+            cycles = (ARM_DWT_CYCCNT - cycles) >> 6;
+            p->cpu_cycles = cycles;
+            if (cycles > p->cpu_cycles_max) p->cpu_cycles_max = cycles;
+        }
+    }
+    totalcycles = (ARM_DWT_CYCCNT - totalcycles) >> 6;
+    cpu_cycles_total = totalcycles;
+    if (totalcycles > cpu_cycles_total_max) cpu_cycles_total_max = totalcycles;
+}
+
+AudioConnection::AudioConnection()
+    : src(nullptr), dst(nullptr), src_index(0), dest_index(0), next_dest(nullptr) {}
+
+AudioConnection::AudioConnection(AudioStream &source, AudioStream &destination)
+    : src(&source), dst(&destination), src_index(0), dest_index(0), next_dest(nullptr) {
+    connect();
+}
+
+AudioConnection::AudioConnection(AudioStream &source, unsigned char sourceOutput,
+                                 AudioStream &destination, unsigned char destinationInput)
+    : src(&source), dst(&destination), src_index(sourceOutput), dest_index(destinationInput), next_dest(nullptr) {
+    connect();
+}
+
+int AudioConnection::connect(AudioStream &source, unsigned char sourceOutput,
+                             AudioStream &destination, unsigned char destinationInput) {
+    if (src) return 1; // already connected (Teensyduino: disconnect() first)
+    src = &source;
+    dst = &destination;
+    src_index = sourceOutput;
+    dest_index = destinationInput;
+    return connect();
+}
+
+int AudioConnection::connect(void) {
+    if (!src || !dst || dest_index >= dst->num_inputs) return 1;
+    AudioConnection **p = &src->destination_list;
+    while (*p) p = &(*p)->next_dest;
+    *p = this;
+    src->active = true;
+    dst->active = true;
+    return 0;
+}
+
+static int16_t saturate16(int32_t val) {
+    if (val > 32767) return 32767;
+    if (val < -32768) return -32768;
+    return val;
+}
+
+void AudioMixer4::update(void) {
+    audio_block_t *in, *out = nullptr;
+    for (unsigned int channel = 0; channel < 4; channel++) {
+        if (!out) {
+            out = receiveWritable(channel);
+            if (out && multiplier[channel] != 65536) {
+                for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+                    out->data[i] = saturate16(((int64_t)out->data[i] * multiplier[channel]) >> 16);
+            }
+        } else {
+            in = receiveReadOnly(channel);
+            if (in) {
+                for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+                    out->data[i] = saturate16(out->data[i] + (int32_t)(((int64_t)in->data[i] * multiplier[channel]) >> 16));
+                release(in);
+            }
+        }
+    }
+    if (out) {
+        transmit(out);
+        release(out);
+    }
+}
+
+void AudioOutputI2S::update(void) {
+    for (unsigned int channel = 0; channel < 2; channel++) {
+        audio_block_t *block = receiveReadOnly(channel);
+        if (block) release(block);
+    }
+}
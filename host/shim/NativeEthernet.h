@@ -0,0 +1,65 @@
+#pragma once
+
+// Host stand-in for the NativeEthernet types used by OpenRemjam.
+
+#include "Arduino.h"
+#include "fnet.h"
+
+/**
+ * @brief Arduino-style IPv4 address. Stored in network byte order, like fnet_ip4_addr_t.
+ *
+ */
+class IPAddress {
+  public:
+    IPAddress() { address.dword = 0; }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+      address.bytes[0] = a;
+      address.bytes[1] = b;
+      address.bytes[2] = c;
+      address.bytes[3] = d;
+    }
+    IPAddress(uint32_t a) { address.dword = a; }
+    IPAddress(const uint8_t *a) { memcpy(address.bytes, a, 4); }
+
+    operator uint32_t() const { return address.dword; }
+    bool operator==(const IPAddress &a) const { return address.dword == a.address.dword; }
+    bool operator!=(const IPAddress &a) const { return address.dword != a.address.dword; }
+    uint8_t operator[](int index) const { return address.bytes[index]; }
+    uint8_t &operator[](int index) { return address.bytes[index]; }
+
+    bool fromString(const String &s) { return fromString(s.c_str()); }
+
+    bool fromString(const char *s) {
+      unsigned int b[4];
+      char tail;
+      if (sscanf(s, "%u.%u.%u.%u%c", &b[0], &b[1], &b[2], &b[3], &tail) != 4) return false;
+      for (int i = 0; i < 4; ++i) {
+        if (b[i] > 255) return false;
+        address.bytes[i] = b[i];
+      }
+      return true;
+    }
+
+  private:
+    union {
+      uint8_t bytes[4];
+      uint32_t dword;
+    } address;
+};
+
+// Declared for the sketch compile check (make sketch), nothing on the host links against it.
+enum EthernetHardwareStatus { EthernetNoHardware, EthernetW5100, EthernetW5200, EthernetW5500 };
+enum EthernetLinkStatus { Unknown, LinkON, LinkOFF };
+
+class EthernetClass {
+  public:
+    int begin(uint8_t *mac);
+    int maintain();
+    EthernetHardwareStatus hardwareStatus();
+    EthernetLinkStatus linkStatus();
+    IPAddress localIP();
+    IPAddress subnetMask();
+    fnet_socket_t socket_ptr[8];
+};
+
+extern EthernetClass Ethernet;
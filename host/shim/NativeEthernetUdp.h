@@ -0,0 +1,18 @@
+#pragma once
+
+// Host stand-in for EthernetUDP of NativeEthernet. Declared for the sketch compile check (make sketch), nothing on
+// the host links against it.
+
+#include "NativeEthernet.h"
+
+class EthernetUDP {
+  public:
+    uint8_t begin(uint16_t port);
+    int parsePacket();
+    int read(uint8_t *buf, size_t size);
+    IPAddress remoteIP();
+    uint16_t remotePort();
+
+  protected:
+    uint8_t sockindex;
+};
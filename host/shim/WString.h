@@ -0,0 +1,21 @@
+#pragma once
+
+// Host stand-in for the Arduino String class, the part the serial commands use.
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+class String {
+  public:
+    String(const char *s = "") : str(s ? s : "") {}
+    unsigned int length() const { return str.length(); }
+    const char *c_str() const { return str.c_str(); }
+    long toInt() const { return atol(str.c_str()); }
+    bool equalsIgnoreCase(const char *s) const { return !strcasecmp(str.c_str(), s); }
+    bool equalsIgnoreCase(const String &s) const { return equalsIgnoreCase(s.c_str()); }
+
+  private:
+    std::string str;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+// Host stand-in for the FNET socket address types and helpers used by OpenRemjam.
+// Layouts follow FNET: fnet_sockaddr_in and fnet_sockaddr_in6 overlay fnet_sockaddr.
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+// glibc defines s6_addr as a macro, FNET uses it as a member name
+#undef s6_addr
+
+typedef char fnet_char_t;
+typedef uint8_t fnet_uint8_t;
+typedef uint16_t fnet_uint16_t;
+typedef uint32_t fnet_uint32_t;
+typedef uint16_t fnet_address_family_t;
+typedef uint32_t fnet_scope_id_t;
+typedef uint32_t fnet_ip4_addr_t;
+
+typedef union {
+    fnet_uint8_t addr[16];
+    fnet_uint16_t addr16[8];
+    fnet_uint32_t addr32[4];
+} fnet_ip6_addr_t;
+
+#define FNET_AF_INET AF_INET
+#define FNET_AF_INET6 AF_INET6
+#define FNET_IP4_ADDR_STR_SIZE (16)
+#define FNET_IP6_ADDR_STR_SIZE (46)
+#define FNET_SA_DATA_SIZE (sizeof(fnet_ip6_addr_t))
+
+#define FNET_IP6_ADDR_EQUAL(a, b) \
+    (((a)->addr32[0] == (b)->addr32[0]) && ((a)->addr32[1] == (b)->addr32[1]) && \
+     ((a)->addr32[2] == (b)->addr32[2]) && ((a)->addr32[3] == (b)->addr32[3]))
+
+struct fnet_in_addr {
+    fnet_ip4_addr_t s_addr;
+};
+
+struct fnet_in6_addr {
+    fnet_ip6_addr_t s6_addr;
+};
+
+struct fnet_sockaddr {
+    fnet_address_family_t sa_family;
+    fnet_uint16_t sa_port;
+    fnet_scope_id_t sa_scope_id;
+    fnet_uint8_t sa_data[FNET_SA_DATA_SIZE];
+};
+
+struct fnet_sockaddr_in {
+    fnet_address_family_t sin_family;
+    fnet_uint16_t sin_port;
+    fnet_scope_id_t sin_scope_id;
+    struct fnet_in_addr sin_addr;
+    fnet_uint8_t sin_zero[FNET_SA_DATA_SIZE - sizeof(struct fnet_in_addr)];
+};
+
+struct fnet_sockaddr_in6 {
+    fnet_address_family_t sin6_family;
+    fnet_uint16_t sin6_port;
+    fnet_scope_id_t sin6_scope_id;
+    struct fnet_in6_addr sin6_addr;
+};
+
+static inline fnet_uint16_t fnet_htons(fnet_uint16_t v) { return htons(v); }
+static inline fnet_uint16_t fnet_ntohs(fnet_uint16_t v) { return ntohs(v); }
+static inline fnet_uint32_t fnet_htonl(fnet_uint32_t v) { return htonl(v); }
+static inline fnet_uint32_t fnet_ntohl(fnet_uint32_t v) { return ntohl(v); }
+
+static inline fnet_char_t *fnet_inet_ntop(fnet_address_family_t family, const void *addr, fnet_char_t *str, fnet_uint32_t str_len) {
+    return (fnet_char_t *)inet_ntop(family, addr, str, str_len);
+}
+
+static inline int fnet_inet_pton(fnet_address_family_t family, const fnet_char_t *str, void *addr, fnet_uint32_t addr_len) {
+    return (inet_pton(family, str, addr) == 1) ? 0 : -1;
+}
+
+// The socket API is declared for the sketch compile check (make sketch), nothing on the host links against it.
+typedef void *fnet_socket_t;
+typedef int fnet_return_t;
+
+#define FNET_NULL (0)
+#define FNET_OK (0)
+#define FNET_ERR (-1)
+
+struct fnet_ip_mreq {
+    struct fnet_in_addr imr_multiaddr;
+    fnet_scope_id_t imr_interface;
+};
+
+int fnet_socket_sendto(fnet_socket_t s, fnet_uint8_t *buf, fnet_uint32_t len, fnet_uint32_t flags, const struct fnet_sockaddr *to, fnet_uint32_t tolen);
+fnet_return_t fnet_socket_setopt(fnet_socket_t s, int level, int optname, const void *optval, fnet_uint32_t optvallen);
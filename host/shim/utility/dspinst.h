@@ -0,0 +1,31 @@
+#pragma once
+
+// Host stand-in for the DSP instruction helpers of the Teensy Audio library (utility/dspinst.h): the same results
+// as SSAT, SMULWB/SMULWT and PKHBT, in portable C. Used by the sketch compile check (make sketch), which builds the
+// __ARM_ARCH_7EM__ paths on the host.
+
+#include <stdint.h>
+
+// computes ((a[31:0] >> rshift) saturated to bits
+static inline int32_t signed_saturate_rshift(int32_t val, int bits, int rshift) {
+    int32_t max = (1 << (bits - 1)) - 1;
+    int32_t v = val >> rshift;
+    if (v > max) return max;
+    if (v < -max - 1) return -max - 1;
+    return v;
+}
+
+// computes ((a[31:0] * b[15:0]) >> 16)
+static inline int32_t signed_multiply_32x16b(int32_t a, uint32_t b) {
+    return ((int64_t)a * (int16_t)(b & 0xffff)) >> 16;
+}
+
+// computes ((a[31:0] * b[31:16]) >> 16)
+static inline int32_t signed_multiply_32x16t(int32_t a, uint32_t b) {
+    return ((int64_t)a * (int16_t)(b >> 16)) >> 16;
+}
+
+// computes (a[15:0] << 16) | b[15:0]
+static inline uint32_t pack_16b_16b(int32_t a, int32_t b) {
+    return ((uint32_t)a << 16) | ((uint32_t)b & 0xffff);
+}
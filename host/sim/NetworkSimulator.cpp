@@ -0,0 +1,162 @@
+#include "NetworkSimulator.h"
+
+#include <stdlib.h>
+
+PlayoutProbe::PlayoutProbe(const PacketTrace &t, uint32_t spp)
+    : AudioStream(1, inputQueueArray), trace(t), samples_per_packet(spp), started(false), last_clean(false), last_pos(-1) {}
+
+void PlayoutProbe::update(void) {
+    audio_block_t *block = receiveReadOnly(0);
+    int64_t now = HostClock::get();
+
+    // the sender has stopped: what follows is not a property of the network or the queue
+    if (trace.events().empty() || now > trace.events().back().arrival_us) {
+        if (block) release(block);
+        return;
+    }
+
+    if (!block) {
+        if (started) {
+            report.blocks_missing++;
+            if (last_clean) report.underruns++;
+        }
+        last_clean = false;
+        return;
+    }
+
+    // a resampling queue interpolates one arbitrary sample where the ramp wraps around: accept such blocks
+    const int16_t near_wrap = 3 * AUDIO_BLOCK_SAMPLES;
+    bool silent = true;
+    bool high = false;
+    bool low = false;
+    int bad_steps = 0;
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; ++i) {
+        if (block->data[i]) silent = false;
+        if (block->data[i] > NetworkSimulator::ramp_period - near_wrap) high = true;
+        if (block->data[i] > 0 && block->data[i] < near_wrap) low = true;
+        if (i) {
+            int d = block->data[i] - block->data[i - 1];
+            if (d < 0 || d > 2) bad_steps++;
+        }
+    }
+    bool ramp = !bad_steps || (bad_steps <= 2 && (high || low));
+
+    if (silent || !ramp) {
+        if (started) {
+            if (silent) report.blocks_silent++;
+            else report.blocks_distorted++;
+            if (last_clean) report.underruns++;
+        }
+        last_clean = false;
+        release(block);
+        return;
+    }
+
+    // recover the absolute sample position from the ramp value (first or last sample, one of them may be interpolated across the wrap)
+    int64_t expected = last_clean ? last_pos + AUDIO_BLOCK_SAMPLES
+                                       : (int64_t)(now * (double)AUDIO_SAMPLE_RATE_EXACT / 1e6);
+    int64_t pos = decode(block->data[0], expected);
+    int64_t pos_last = decode(block->data[AUDIO_BLOCK_SAMPLES - 1], expected + AUDIO_BLOCK_SAMPLES - 1) - (AUDIO_BLOCK_SAMPLES - 1);
+    if (llabs(pos_last - expected) < llabs(pos - expected)) pos = pos_last;
+
+    if (last_clean && llabs(pos - (last_pos + AUDIO_BLOCK_SAMPLES)) > 2) report.discontinuities++;
+
+    const TraceEvent *e = trace.find(pos / samples_per_packet);
+    if (e) {
+        report.buffering_us.add(now - e->arrival_us);
+        if (e->send_us >= 0) report.e2e_us.add(now - e->send_us);
+    }
+
+    if (!started) {
+        started = true;
+        report.first_audio_us = now;
+    }
+    report.blocks_audio++;
+    last_clean = true;
+    last_pos = pos;
+    release(block);
+}
+
+int64_t PlayoutProbe::decode(int16_t value, int64_t expected) {
+    int64_t v = value - 1;
+    int64_t k = (expected - v + NetworkSimulator::ramp_period / 2) / NetworkSimulator::ramp_period;
+    if (k < 0) k = 0;
+    return v + k * NetworkSimulator::ramp_period;
+}
+
+NetworkSimulator::NetworkSimulator(QueueController &q) : qc(q) {}
+
+NetworkSimulator::~NetworkSimulator() {
+    // probes stay registered in the audio graph, so they are intentionally not deleted
+}
+
+int NetworkSimulator::addPeer(const PacketTrace &trace) {
+    int qi = qc.getFreeQueueIndex();
+    if (qi < 0 || !qc.connect(qi, IPAddress(10, 0, (qi >> 8) & 0xff, qi & 0xff), OPENREMJAM_DEFAULT_UDP_PORT)) return -1;
+    PlayoutProbe *probe = new PlayoutProbe(trace, qc.getQueue(qi)->getBlocksPerPacket() * AUDIO_BLOCK_SAMPLES);
+    AudioConnection *con = new AudioConnection(*qc.getQueue(qi), 0, *probe, 0);
+    peers.push_back(Peer{qi, &trace, 0, probe, con});
+    return qi;
+}
+
+void NetworkSimulator::deliver(Peer &p, const TraceEvent &e) {
+    // receive like the firmware does: header first, then the payload straight into the queue's receive buffer
+    NetworkJitterBufferPlayQueue *q = qc.getQueue(p.queue_index);
+    const uint32_t blocks = q->getBlocksPerPacket();
+    const uint32_t n = blocks * AUDIO_BLOCK_SAMPLES;
+    openremjam_header_t h;
+    fillHeader(h, e.parity_group ? PacketType::parity : PacketType::audio, Codec::pcm, e.seqno, blocks, e.parity_group);
+    int16_t *samples = (int16_t *)q->getPayloadBuffer(h, q->getPacketSize());
+    if (!samples) return;
+    int64_t pos = (int64_t)e.seqno * n;
+    for (uint32_t i = 0; i < n; ++i) {
+        // FEC parity packet: XOR of the group's samples
+        int16_t v = signal(pos + i);
+        for (uint32_t k = 1; k < e.parity_group; ++k) v ^= signal(pos + k * n + i);
+        samples[i] = v;
+    }
+    q->commitPayload(h);
+}
+
+void NetworkSimulator::run(int64_t duration_us) {
+    const double block_us = AUDIO_BLOCK_SAMPLES * 1e6 / AUDIO_SAMPLE_RATE_EXACT;
+    uint64_t tick = 0;
+
+    for (;;) {
+        int64_t next_tick = (int64_t)(tick * block_us);
+        if (next_tick > duration_us) break;
+
+        // deliver all packets that arrive before the next audio interrupt
+        for (;;) {
+            Peer *earliest = nullptr;
+            for (Peer &p : peers) {
+                const std::vector<TraceEvent> &ev = p.trace->events();
+                if (p.next < ev.size() && ev[p.next].arrival_us <= next_tick &&
+                    (!earliest || ev[p.next].arrival_us < earliest->trace->events()[earliest->next].arrival_us))
+                    earliest = &p;
+            }
+            if (!earliest) break;
+            const TraceEvent &e = earliest->trace->events()[earliest->next++];
+            if (e.arrival_us > (int64_t)HostClock::get()) HostClock::set(e.arrival_us);
+            deliver(*earliest, e);
+        }
+
+        HostClock::set(next_tick);
+        AudioStream::update_all();
+        EventLog::flush(); // like loop() on the Teensy
+        qc.printStatisticsIfDue();
+        tick++;
+    }
+
+    for (Peer &p : peers) {
+        NetworkJitterBufferPlayQueue *q = qc.getQueue(p.queue_index);
+        p.probe->report.late_packets = q->getLatePackets();
+        p.probe->report.early_packets = q->getEarlyPackets();
+        p.probe->report.recoveries_success = q->getRecoveriesSuccess();
+        p.probe->report.recoveries_failed = q->getRecoveriesFailed();
+        p.probe->report.concealed_packets = q->getConcealedPackets();
+        p.probe->report.fec_recovered_packets = q->getFecRecoveredPackets();
+    }
+}
+
+const PeerReport &NetworkSimulator::getReport(int i) { return peers[i].probe->report; }
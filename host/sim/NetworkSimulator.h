@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vector>
+
+#include "Audio.h"
+#include "QueueController.h"
+#include "PacketTrace.h"
+
+/**
+ * @brief Running minimum/average/maximum of a series of values
+ *
+ */
+struct RunningStats {
+  uint64_t n = 0;
+  double min = 0;
+  double max = 0;
+  double sum = 0;
+
+  void add(double v) {
+    if (!n || v < min) min = v;
+    if (!n || v > max) max = v;
+    sum += v;
+    n++;
+  }
+  double avg() const { return n ? sum / n : 0; }
+};
+
+/**
+ * @brief What one peer's listener heard, plus the queue's own counters
+ *
+ */
+struct PeerReport {
+  uint32_t blocks_audio = 0;      // blocks carrying the sender's signal in order
+  uint32_t blocks_missing = 0;    // no block played (queue syncing or stopped) after playback had started
+  uint32_t blocks_silent = 0;     // zero-filled blocks (faded out concealment, recovery)
+  uint32_t blocks_distorted = 0;  // blocks that are neither silence nor the sender's signal (includes concealed audio)
+  uint32_t discontinuities = 0;   // signal resumed at an unexpected position (skipped or repeated audio)
+  uint32_t underruns = 0;         // transitions from clean audio to silence or missing blocks
+  int64_t first_audio_us = -1;    // time of the first clean block
+  RunningStats e2e_us;            // playout time minus the time the packet was sent
+  RunningStats buffering_us;      // playout time minus the time the packet arrived (added latency)
+  uint32_t late_packets = 0;
+  uint32_t early_packets = 0;
+  uint32_t recoveries_success = 0;
+  uint32_t recoveries_failed = 0;
+  uint32_t concealed_packets = 0;
+  uint32_t fec_recovered_packets = 0;
+
+  uint32_t glitches() const { return blocks_missing + blocks_silent + blocks_distorted + discontinuities; }
+};
+
+/**
+ * @brief Listens to the output of one play queue and checks it against the sender's test signal
+ *
+ */
+class PlayoutProbe : public AudioStream {
+  public:
+    PlayoutProbe(const PacketTrace &t, uint32_t samples_per_packet);
+    virtual void update(void);
+    PeerReport report;
+
+  private:
+    static int64_t decode(int16_t value, int64_t expected);
+    const PacketTrace &trace;
+    uint32_t samples_per_packet;
+    bool started;
+    bool last_clean;
+    int64_t last_pos;
+    audio_block_t *inputQueueArray[1];
+};
+
+/**
+ * @brief Replays packet arrival traces into the queues of a QueueController and drives the audio graph on a virtual clock
+ *
+ */
+class NetworkSimulator {
+  public:
+    NetworkSimulator(QueueController &qc);
+    ~NetworkSimulator();
+
+    /**
+     * @brief Attach a peer. The next free queue is connected and fed from the trace.
+     *
+     * @param trace arrivals of this peer (must outlive the simulator)
+     * @return int queue index or -1 if no queue is free, or it gets no slots from the block pool
+     */
+    int addPeer(const PacketTrace &trace);
+
+    /**
+     * @brief Run the simulation
+     *
+     * @param duration_us simulated time
+     */
+    void run(int64_t duration_us);
+
+    /**
+     * @brief Get the report of a peer
+     *
+     * @param i peer number in the order of addPeer()
+     * @return const PeerReport&
+     */
+    const PeerReport &getReport(int i);
+
+    int getPeerCount() { return peers.size(); }
+
+    /**
+     * @brief Sender test signal: a ramp over the sample position, never zero
+     *
+     * @param pos sample position at the sender
+     * @return int16_t sample value
+     */
+    static int16_t signal(int64_t pos) { return 1 + (pos % ramp_period); }
+    static const int64_t ramp_period = 30000;
+
+  private:
+    struct Peer {
+      int queue_index;
+      const PacketTrace *trace;
+      size_t next;
+      PlayoutProbe *probe;
+      AudioConnection *con;
+    };
+    void deliver(Peer &p, const TraceEvent &e);
+    QueueController &qc;
+    std::vector<Peer> peers;
+};
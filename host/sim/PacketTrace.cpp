@@ -0,0 +1,111 @@
+#include "PacketTrace.h"
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+
+bool PacketTrace::load(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    ev.clear();
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char *hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        unsigned long seqno, group;
+        long long a, b;
+        if (sscanf(line, " p %lu %lu %lld %lld", &seqno, &group, &a, &b) == 4) {
+            ev.push_back(TraceEvent{(uint32_t)seqno, a, b, (uint32_t)group});
+            continue;
+        }
+        int n = sscanf(line, "%lu %lld %lld", &seqno, &a, &b);
+        if (n == 2) {
+            ev.push_back(TraceEvent{(uint32_t)seqno, -1, a});
+        } else if (n == 3) {
+            ev.push_back(TraceEvent{(uint32_t)seqno, a, b});
+        }
+    }
+    fclose(f);
+    sortAndIndex();
+    return true;
+}
+
+bool PacketTrace::save(const char *path) const {
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "# seqno send_us arrival_us\n");
+    for (const TraceEvent &e : ev) {
+        if (e.parity_group) fprintf(f, "p %lu %lu", (unsigned long)e.seqno, (unsigned long)e.parity_group);
+        else fprintf(f, "%lu", (unsigned long)e.seqno);
+        fprintf(f, " %lld %lld\n", (long long)e.send_us, (long long)e.arrival_us);
+    }
+    fclose(f);
+    return true;
+}
+
+void PacketTrace::generate(const TraceConfig &cfg) {
+    std::mt19937 rng(cfg.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, cfg.jitter_us > 0 ? cfg.jitter_us : 1.0);
+
+    // sender clock: a positive drift makes the sender produce packets faster than the receiver consumes them
+    double period = cfg.packet_us / (1.0 + cfg.drift_ppm * 1e-6);
+
+    std::vector<TraceEvent> sent(cfg.packets);
+    for (uint32_t s = 0; s < cfg.packets; ++s) {
+        double send = (s + 1) * period;
+        double jitter = cfg.jitter_us > 0 ? fabs(normal(rng)) : 0.0;
+        sent[s] = TraceEvent{s, (int64_t)send, (int64_t)(send + cfg.delay_us + jitter)};
+    }
+
+    // bursts: hold packets back and release them together with the last one
+    for (uint32_t s = 0; s < cfg.packets; ++s) {
+        if (cfg.burst_len > 1 && uniform(rng) < cfg.burst_prob) {
+            uint32_t last = std::min(s + cfg.burst_len, cfg.packets) - 1;
+            for (uint32_t i = s; i < last; ++i) {
+                sent[i].arrival_us = std::max(sent[i].arrival_us, sent[last].arrival_us);
+            }
+            s = last;
+        }
+    }
+
+    // reordering: the packet arrives after its successor
+    for (uint32_t s = 0; s + 1 < cfg.packets; ++s) {
+        if (uniform(rng) < cfg.reorder) {
+            int64_t a = sent[s].arrival_us;
+            sent[s].arrival_us = std::max(a, sent[s + 1].arrival_us) + 1;
+            sent[s + 1].arrival_us = std::min(a, sent[s + 1].arrival_us);
+            ++s;
+        }
+    }
+
+    ev.clear();
+    for (const TraceEvent &e : sent) {
+        if (uniform(rng) >= cfg.loss) ev.push_back(e);
+    }
+
+    // FEC: the parity packet is sent back-to-back with the last packet of its group and arrives right behind it.
+    // Drawn last, so the audio packets are the same with and without FEC
+    for (uint32_t s = 0; cfg.fec_group > 1 && s + cfg.fec_group <= cfg.packets; s += cfg.fec_group) {
+        const TraceEvent &last = sent[s + cfg.fec_group - 1];
+        if (uniform(rng) >= cfg.loss) ev.push_back(TraceEvent{s, last.send_us, last.arrival_us + 1, cfg.fec_group});
+    }
+    sortAndIndex();
+}
+
+const TraceEvent *PacketTrace::find(uint32_t seqno) const {
+    auto it = by_seqno.find(seqno);
+    return (it == by_seqno.end()) ? nullptr : &ev[it->second];
+}
+
+void PacketTrace::sortAndIndex() {
+    std::stable_sort(ev.begin(), ev.end(), [](const TraceEvent &a, const TraceEvent &b) {
+        return a.arrival_us < b.arrival_us;
+    });
+    by_seqno.clear();
+    for (size_t i = 0; i < ev.size(); ++i) {
+        if (!ev[i].parity_group) by_seqno[ev[i].seqno] = i;
+    }
+}
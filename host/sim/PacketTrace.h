@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief One received datagram: sequence number, time it left the sender and time it arrived (both receiver clock).
+ *        A FEC parity packet covers the parity_group packets starting at seqno.
+ *
+ */
+struct TraceEvent {
+  uint32_t seqno;
+  int64_t send_us;     // -1 if unknown (trace files with two columns)
+  int64_t arrival_us;
+  uint32_t parity_group = 0; // 0: audio packet
+};
+
+/**
+ * @brief Parameters of the synthetic network model
+ *
+ */
+struct TraceConfig {
+  uint32_t packets = 10000;       // number of packets the sender emits
+  double packet_us = 0;           // nominal packet duration at the sender (0: derive from the audio configuration)
+  double delay_us = 1000;         // constant one-way network delay
+  double jitter_us = 0;           // standard deviation of the additional (non-negative) delay
+  double loss = 0;                // probability that a packet is lost
+  double reorder = 0;             // probability that a packet swaps its arrival time with its successor
+  double burst_prob = 0;          // probability that a burst starts at a packet
+  uint32_t burst_len = 4;         // packets held back and delivered at once per burst
+  double drift_ppm = 0;           // sender sampling clock deviation (positive: sender is faster)
+  uint32_t fec_group = 0;         // packets per FEC parity packet (0: no parity packets)
+  uint32_t seed = 1;
+};
+
+/**
+ * @brief Sequence of packet arrivals, sorted by arrival time
+ *
+ */
+class PacketTrace {
+  public:
+    /**
+     * @brief Load a trace file. One packet per line: "<seqno> <arrival_us>" or "<seqno> <send_us> <arrival_us>",
+     *        parity packets "p <first_seqno> <group> <send_us> <arrival_us>", '#' starts a comment
+     *
+     * @param path file name
+     * @return true on success
+     */
+    bool load(const char *path);
+
+    /**
+     * @brief Write the trace in the three-column file format
+     *
+     * @param path file name
+     * @return true on success
+     */
+    bool save(const char *path) const;
+
+    /**
+     * @brief Replace the trace by synthetic arrivals
+     *
+     * @param cfg network model parameters
+     */
+    void generate(const TraceConfig &cfg);
+
+    /**
+     * @brief Look up the event of a sequence number (audio packets only)
+     *
+     * @param seqno sequence number
+     * @return const TraceEvent* event or nullptr if the packet never arrived
+     */
+    const TraceEvent *find(uint32_t seqno) const;
+
+    const std::vector<TraceEvent> &events() const { return ev; }
+
+  private:
+    void sortAndIndex();
+    std::vector<TraceEvent> ev;
+    std::unordered_map<uint32_t, size_t> by_seqno; // index into ev
+};
@@ -0,0 +1,210 @@
+// openremjam-sim: replays packet arrival traces into NetworkJitterBufferPlayQueue on a virtual audio clock
+// and reports what a listener would hear. See README.md, section "Host build and network simulator".
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "NetworkSimulator.h"
+
+// queues are constructed on first use, before the QueueController's mixers (the audio graph updates in construction order)
+template <uint32_t CAPACITY, uint32_t BLOCKS>
+static void makeQueues(NetworkJitterBufferPlayQueue * (&ptr)[OPENREMJAM_MAX_PEERS]) {
+    static NetworkJitterBufferRing<CAPACITY, BLOCKS> queues[OPENREMJAM_MAX_PEERS];
+    for (int i = 0; i < OPENREMJAM_MAX_PEERS; ++i) ptr[i] = &queues[i];
+}
+
+template <uint32_t BLOCKS>
+static bool makeQueues(int capacity, NetworkJitterBufferPlayQueue * (&ptr)[OPENREMJAM_MAX_PEERS]) {
+    switch (capacity) {
+        case 4: makeQueues<4, BLOCKS>(ptr); return true;
+        case 8: makeQueues<8, BLOCKS>(ptr); return true;
+        case 16: makeQueues<16, BLOCKS>(ptr); return true;
+        case 32: makeQueues<32, BLOCKS>(ptr); return true;
+        default: return false;
+    }
+}
+
+static void usage() {
+    printf("Usage: openremjam-sim [options]\r\n"
+           "Network (one trace per peer, generated unless --trace is given):\r\n"
+           "  --trace FILE        replay arrivals from FILE (all peers)\r\n"
+           "  --peers N           number of peers, 1...%d (default 1, queue 0 is the loopback queue)\r\n"
+           "  --duration S        simulated seconds (default 10)\r\n"
+           "  --delay US          one-way network delay (default 1000)\r\n"
+           "  --jitter US         standard deviation of the extra delay (default 0)\r\n"
+           "  --loss P            packet loss probability (default 0)\r\n"
+           "  --reorder P         reordering probability (default 0)\r\n"
+           "  --burst P           burst probability (default 0)\r\n"
+           "  --burst-len N       packets per burst (default 4)\r\n"
+           "  --drift PPM         sender clock drift (default 0)\r\n"
+           "  --fec K             send one FEC parity packet per K packets (default 0: off)\r\n"
+           "  --seed N            random seed of peer 1 (default 1)\r\n"
+           "  --dump-trace FILE   write the trace of peer 1 and exit\r\n"
+           "Queue:\r\n"
+           "  --capacity N        slots per queue: 4, 8, 16 or 32 (default %d)\r\n"
+           "  --blocks N          audio blocks per network block: 2, 4, 8 or 16 (default %d)\r\n"
+           "  --max-buffers N     setMaxBuffers(N)\r\n"
+           "  --prefill N         setPrefill(N) (after --max-buffers)\r\n"
+           "  --adaptive          enable the adaptive buffer depth\r\n"
+           "  --event-rate N      tolerated late packets + recoveries per 10000 blocks (adaptive mode)\r\n"
+           "  --no-drift-comp     disable the clock drift compensation\r\n"
+           "Output:\r\n"
+           "  --csv               one CSV line per peer\r\n"
+           "  --verbose           show the firmware's serial output\r\n"
+           "  --max-glitches N    exit with status 1 if a peer has more than N glitch blocks\r\n",
+           OPENREMJAM_MAX_PEERS - 1, OPENREMJAM_PLAY_QUEUE_SIZE, OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK);
+}
+
+static void printReport(int peer, const PeerReport &r, bool csv) {
+    if (csv) {
+        printf("%d,%u,%u,%u,%u,%u,%u,%lld,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%u,%u,%u,%u,%u,%u\r\n",
+               peer, r.blocks_audio, r.blocks_missing, r.blocks_silent, r.blocks_distorted, r.discontinuities,
+               r.underruns, (long long)r.first_audio_us,
+               r.e2e_us.min, r.e2e_us.avg(), r.e2e_us.max,
+               r.buffering_us.min, r.buffering_us.avg(), r.buffering_us.max,
+               r.late_packets, r.early_packets, r.recoveries_success, r.recoveries_failed, r.concealed_packets,
+               r.fec_recovered_packets);
+        return;
+    }
+    printf("Peer %d\r\n", peer);
+    printf("Blocks audio/missing/silent/distorted: %u / %u / %u / %u\r\n",
+           r.blocks_audio, r.blocks_missing, r.blocks_silent, r.blocks_distorted);
+    printf("Underruns, discontinuities:            %u, %u\r\n", r.underruns, r.discontinuities);
+    printf("First audio:                           %.1f ms\r\n", r.first_audio_us / 1000.0);
+    printf("End-to-end latency min/avg/max:        %.0f / %.0f / %.0f us\r\n", r.e2e_us.min, r.e2e_us.avg(), r.e2e_us.max);
+    printf("Added latency min/avg/max:             %.0f / %.0f / %.0f us\r\n", r.buffering_us.min, r.buffering_us.avg(), r.buffering_us.max);
+    printf("Early/late packets:                    %u / %u\r\n", r.early_packets, r.late_packets);
+    printf("Recoveries succ/fail:                  %u / %u\r\n", r.recoveries_success, r.recoveries_failed);
+    printf("Concealed packets:                     %u\r\n", r.concealed_packets);
+    printf("FEC recovered packets:                 %u\r\n", r.fec_recovered_packets);
+    printf("===============================\r\n");
+}
+
+int main(int argc, char **argv) {
+    TraceConfig cfg;
+    const char *trace_file = nullptr;
+    const char *dump_file = nullptr;
+    int peer_count = 1;
+    double duration_s = 10;
+    int capacity = OPENREMJAM_PLAY_QUEUE_SIZE;
+    int blocks = OPENREMJAM_AUDIO_BLOCKS_PER_NETWORK_BLOCK;
+    int max_buffers = -1;
+    int prefill = -1;
+    bool adaptive = false;
+    bool drift_compensation = true;
+    int event_rate = -1;
+    bool csv = false;
+    bool verbose = false;
+    long max_glitches = -1;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool takes_value = true;
+        if (!strcmp(a, "--trace") && v) trace_file = v;
+        else if (!strcmp(a, "--peers") && v) peer_count = atoi(v);
+        else if (!strcmp(a, "--duration") && v) duration_s = atof(v);
+        else if (!strcmp(a, "--delay") && v) cfg.delay_us = atof(v);
+        else if (!strcmp(a, "--jitter") && v) cfg.jitter_us = atof(v);
+        else if (!strcmp(a, "--loss") && v) cfg.loss = atof(v);
+        else if (!strcmp(a, "--reorder") && v) cfg.reorder = atof(v);
+        else if (!strcmp(a, "--burst") && v) cfg.burst_prob = atof(v);
+        else if (!strcmp(a, "--burst-len") && v) cfg.burst_len = atoi(v);
+        else if (!strcmp(a, "--drift") && v) cfg.drift_ppm = atof(v);
+        else if (!strcmp(a, "--fec") && v) cfg.fec_group = atoi(v);
+        else if (!strcmp(a, "--seed") && v) cfg.seed = atoi(v);
+        else if (!strcmp(a, "--dump-trace") && v) dump_file = v;
+        else if (!strcmp(a, "--capacity") && v) capacity = atoi(v);
+        else if (!strcmp(a, "--blocks") && v) blocks = atoi(v);
+        else if (!strcmp(a, "--max-buffers") && v) max_buffers = atoi(v);
+        else if (!strcmp(a, "--prefill") && v) prefill = atoi(v);
+        else if (!strcmp(a, "--event-rate") && v) event_rate = atoi(v);
+        else if (!strcmp(a, "--max-glitches") && v) max_glitches = atol(v);
+        else {
+            takes_value = false;
+            if (!strcmp(a, "--csv")) csv = true;
+            else if (!strcmp(a, "--verbose")) verbose = true;
+            else if (!strcmp(a, "--adaptive")) adaptive = true;
+            else if (!strcmp(a, "--no-drift-comp")) drift_compensation = false;
+            else {
+                usage();
+                return strcmp(a, "--help") ? 2 : 0;
+            }
+        }
+        if (takes_value) ++i;
+    }
+    if (peer_count < 1 || peer_count > OPENREMJAM_MAX_PEERS - 1) {
+        fprintf(stderr, "--peers must be in range 1...%d, queue 0 is the loopback queue\n", OPENREMJAM_MAX_PEERS - 1);
+        return 2;
+    }
+
+    NetworkJitterBufferPlayQueue *queue_ptr[OPENREMJAM_MAX_PEERS];
+    bool shape_ok = false;
+    switch (blocks) {
+        case 2: shape_ok = makeQueues<2>(capacity, queue_ptr); break;
+        case 4: shape_ok = makeQueues<4>(capacity, queue_ptr); break;
+        case 8: shape_ok = makeQueues<8>(capacity, queue_ptr); break;
+        case 16: shape_ok = makeQueues<16>(capacity, queue_ptr); break;
+    }
+    if (!shape_ok) {
+        usage();
+        return 2;
+    }
+    QueueController qc(queue_ptr);
+
+    Serial.setEnabled(verbose);
+    AudioMemory(OPENREMJAM_AUDIO_MEMORY);
+
+    cfg.packet_us = AUDIO_BLOCK_SAMPLES * blocks * 1e6 / AUDIO_SAMPLE_RATE_EXACT;
+    int64_t duration_us = (int64_t)(duration_s * 1e6);
+    if (!trace_file) cfg.packets = duration_us / cfg.packet_us + 1;
+
+    std::vector<PacketTrace> traces(peer_count);
+    for (int p = 0; p < peer_count; ++p) {
+        if (trace_file) {
+            if (!traces[p].load(trace_file)) {
+                fprintf(stderr, "Cannot read trace file %s\n", trace_file);
+                return 2;
+            }
+        } else {
+            TraceConfig c = cfg;
+            c.seed = cfg.seed + p;
+            traces[p].generate(c);
+        }
+    }
+
+    if (dump_file) {
+        return traces[0].save(dump_file) ? 0 : 2;
+    }
+
+    NetworkSimulator sim(qc);
+    for (int p = 0; p < peer_count; ++p) {
+        int qi = sim.addPeer(traces[p]);
+        if (qi < 0) {
+            fprintf(stderr, "No free queue (or block pool slots) for peer %d\n", p + 1);
+            return 2;
+        }
+        if (max_buffers > 0) qc.getQueue(qi)->setMaxBuffers(max_buffers);
+        if (prefill > 0) qc.getQueue(qi)->setPrefill(prefill);
+        if (event_rate >= 0) qc.getQueue(qi)->setAdaptiveMaxEventRate(event_rate);
+        qc.getQueue(qi)->setAdaptive(adaptive);
+        qc.getQueue(qi)->setDriftCompensation(drift_compensation);
+    }
+
+    sim.run(duration_us);
+
+    if (csv) {
+        printf("peer,audio,missing,silent,distorted,discontinuities,underruns,first_audio_us,"
+               "e2e_min_us,e2e_avg_us,e2e_max_us,added_min_us,added_avg_us,added_max_us,"
+               "late,early,recoveries_success,recoveries_failed,concealed,fec_recovered\r\n");
+    }
+    int status = 0;
+    for (int p = 0; p < sim.getPeerCount(); ++p) {
+        const PeerReport &r = sim.getReport(p);
+        printReport(p + 1, r, csv);
+        if (max_glitches >= 0 && r.glitches() > (uint32_t)max_glitches) status = 1;
+    }
+    return status;
+}